@@ -0,0 +1,107 @@
+/*
+ * Tux Droid - Daemon protocol
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_daemon_protocol.h
+ * \brief Framing of the messages exchanged with the tux daemon.
+ *
+ * The daemon owns the dongle and serves its clients on a Unix domain
+ * stream socket. Every message is a tux_daemon_header_t followed by
+ * length bytes of payload. The fields are in the byte order of the host.
+ *
+ * Each request gets a TUX_MSG_RESULT answer, in order. The status events
+ * of the subscribed statuses are sent as TUX_MSG_EVENT messages; a client
+ * which does not read them fast enough loses events, and receives a
+ * TUX_MSG_EVENTS_LOST message with their number when it catches up.
+ */
+
+#ifndef _TUX_DAEMON_PROTOCOL_H_
+#define _TUX_DAEMON_PROTOCOL_H_
+
+#include <stdint.h>
+
+/** \brief Default path of the daemon socket */
+#define TUX_DAEMON_SOCKET_PATH          "/tmp/tuxdaemon.sock"
+/** \brief Maximal size of a payload */
+#define TUX_DAEMON_MAX_PAYLOAD          16384
+/** \brief Maximal length of the text of a command (CMDSIZE - 1) */
+#define TUX_DAEMON_MAX_COMMAND          1023
+/** \brief Maximal length of the text of a macro (MACROSIZE - 1) */
+#define TUX_DAEMON_MAX_MACRO            16383
+
+/** \brief Message types */
+typedef enum {
+    /* Requests */
+    TUX_MSG_COMMAND = 1, /**< tux_daemon_command_t then the command */
+    TUX_MSG_MACRO, /**< Text of the macro */
+    TUX_MSG_CLEAR, /**< Clear the command stack, no payload */
+    TUX_MSG_SUBSCRIBE, /**< tux_daemon_subscribe_t */
+    /* Answers and notifications */
+    TUX_MSG_RESULT = 0x80, /**< tux_daemon_result_t */
+    TUX_MSG_EVENT, /**< tux_daemon_event_t then the string value */
+    TUX_MSG_EVENTS_LOST, /**< tux_daemon_events_lost_t */
+} tux_daemon_msg_type_t;
+
+/** \brief Header of a message */
+typedef struct {
+    uint16_t    type; /**< Message type (tux_daemon_msg_type_t) */
+    uint16_t    reserved; /**< Must be 0 */
+    uint32_t    length; /**< Size of the payload */
+} tux_daemon_header_t;
+
+/** \brief Payload of TUX_MSG_COMMAND, followed by the command string
+ * (as TuxDrv_QueueCommand) without its terminating null. A command without
+ * delay is executed by the next read cycle of the driver. A longer text
+ * than TUX_DAEMON_MAX_COMMAND is refused with E_TUXDRV_INVALIDPARAMETER,
+ * as a macro longer than TUX_DAEMON_MAX_MACRO */
+typedef struct {
+    float       delay; /**< Delay before the execution (seconds) */
+} tux_daemon_command_t;
+
+/** \brief Payload of TUX_MSG_SUBSCRIBE */
+typedef struct {
+    uint64_t    mask; /**< Statuses to receive (STATUS_MASK) */
+} tux_daemon_subscribe_t;
+
+/** \brief Payload of TUX_MSG_RESULT */
+typedef struct {
+    uint16_t    request; /**< Type of the request answered */
+    uint16_t    reserved;
+    int32_t     error; /**< TuxDrvError of the request */
+} tux_daemon_result_t;
+
+/** \brief Payload of TUX_MSG_EVENT, followed by the value of a string
+ * status without its terminating null */
+typedef struct {
+    int32_t     id; /**< Status identifier (SW_ID) */
+    int32_t     value_fmt; /**< Type of the value (ID_FMT) */
+    int32_t     intvalue; /**< Value of the bool, uint8 and int statuses */
+    float       floatvalue; /**< Value of the float statuses */
+    double      timestamp; /**< Monotonic time of the change (seconds) */
+    uint32_t    seq; /**< Sequence number of the event */
+    uint32_t    reserved;
+} tux_daemon_event_t;
+
+/** \brief Payload of TUX_MSG_EVENTS_LOST */
+typedef struct {
+    uint32_t    count; /**< Events not sent since the last message */
+} tux_daemon_events_lost_t;
+
+#endif /* _TUX_DAEMON_PROTOCOL_H_ */
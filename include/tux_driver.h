@@ -22,6 +22,7 @@
 #define _TUX_DRIVER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Id enumeration of high level status.
@@ -68,8 +69,33 @@ typedef enum {
     SW_ID_SPIN_LEFT_MOTOR_ON,
     SW_ID_SPIN_RIGHT_MOTOR_ON,
     SW_ID_FLASH_SOUND_COUNT,
+    SW_ID_SOUND_REFLASH_TRACK_PROGRESS,
+    SW_STATUS_NUMBER,
 } SW_ID_DRIVER;
 
+/**
+ * Bit of a status in a subscription mask, and mask of all the statuses.
+ */
+#define STATUS_MASK(id)     (((uint64_t)1) << (id))
+#define STATUS_MASK_ALL     (~((uint64_t)0))
+
+/**
+ * Statuses a snapshot can hold. It is fixed, so the snapshot keeps its
+ * size when statuses are added : only the first count values are valid.
+ */
+#define STATUS_SNAPSHOT_CAPACITY 64
+
+/**
+ * Value types of the high level status.
+ */
+typedef enum {
+    ID_FMT_BOOL = 0,
+    ID_FMT_UINT8,
+    ID_FMT_INT,
+    ID_FMT_FLOAT,
+    ID_FMT_STRING,
+} ID_FMT_DRIVER;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -92,6 +118,10 @@ typedef enum
     E_TUXDRV_INVALIDPARAMETER,
     E_TUXDRV_BUSY,
     E_TUXDRV_WAVSIZEEXCEDED,
+    E_TUXDRV_WAVNOTFOUND,
+    E_TUXDRV_WAVNOTRIFF,
+    E_TUXDRV_WAVNODATA,
+    E_TUXDRV_WAVBADFORMAT,
 } tux_drv_error_t;
 
 /**
@@ -106,6 +136,29 @@ typedef enum {
     INVALID_CPU_NUM     = -1,
 } CPU_IDENTIFIERS;
 
+/**
+ * Command lanes enumeration.
+ */
+typedef enum {
+    CMD_LANE_EYES = 0,
+    CMD_LANE_MOUTH,
+    CMD_LANE_FLIPPERS,
+    CMD_LANE_SPINNING,
+    CMD_LANE_LEFT_LED,
+    CMD_LANE_RIGHT_LED,
+    CMD_LANE_AUDIO,
+    CMD_LANE_IR,
+} CMD_LANE;
+
+/**
+ * Command lane policies.
+ */
+typedef enum {
+    LANE_POLICY_QUEUE = 0,
+    LANE_POLICY_REPLACE,
+    LANE_POLICY_PREEMPT,
+} LANE_POLICY;
+
 /**
  * Descriptor structure of a firmaware.
  */
@@ -163,6 +216,26 @@ typedef struct {
     id_descriptor_t *id;
 } tux_descriptor_t;
 
+/**
+ * Seconds covered by the frames rate of a macro analysis.
+ */
+#define ANALYSIS_SECONDS 600
+
+/**
+ * Result of a macro analysis.
+ */
+typedef struct {
+    float           duration;
+    unsigned int    frame_count;
+    unsigned int    peak_burst;
+    float           peak_burst_time;
+    unsigned int    overrun_count;
+    unsigned int    conflict_count;
+    bool            truncated;
+    unsigned int    seconds;
+    unsigned int    fps[ANALYSIS_SECONDS];
+} macro_analysis_t;
+
 /**
  * Simple callback definition.
  */
@@ -173,6 +246,153 @@ typedef void(*drv_simple_callback_t)(void);
  */
 typedef void(*drv_status_callback_t)(char *status);
 
+/**
+ * Time source definition, returns the current time in seconds.
+ */
+typedef double(*drv_time_funct_t)(void);
+
+/**
+ * Sleep function definition, waits a duration in seconds.
+ */
+typedef void(*drv_sleep_funct_t)(double seconds);
+
+/**
+ * Binary status event.
+ */
+typedef struct {
+    int             id;
+    int             value_fmt;
+    int             intvalue;
+    float           floatvalue;
+    const char      *strvalue;
+    double          timestamp;
+    unsigned int    seq;
+} drv_status_event_t;
+
+/**
+ * Binary status callback definition.
+ */
+typedef void(*drv_status_ex_callback_t)(const drv_status_event_t *event);
+
+/**
+ * Batch status callback definition, called at the end of a read cycle with
+ * the events of the cycle.
+ */
+typedef void(*drv_status_batch_callback_t)(const drv_status_event_t *events,
+    int count);
+
+/**
+ * Thread which calls the status callbacks.
+ */
+typedef enum {
+    STATUS_DISPATCH_SYNC = 0,
+    STATUS_DISPATCH_THREAD,
+    STATUS_DISPATCH_POLL,
+} STATUS_DISPATCH_MODE;
+
+/**
+ * Behaviour of a full status event queue.
+ */
+typedef enum {
+    STATUS_OVERFLOW_DROP_OLDEST = 0,
+    STATUS_OVERFLOW_COALESCE,
+    STATUS_OVERFLOW_BLOCK,
+} STATUS_OVERFLOW_POLICY;
+
+/**
+ * Counters of the status event queue.
+ */
+typedef struct {
+    unsigned int    depth;
+    unsigned int    max_depth;
+    unsigned int    dropped;
+    unsigned int    coalesced;
+    unsigned int    blocked;
+} drv_status_dispatch_stats_t;
+
+/**
+ * Counters of the link, indexes of drv_stats_t.counters and rates.
+ */
+typedef enum {
+    STATS_USB_READS = 0,
+    STATS_USB_READ_FAILURES,
+    STATS_USB_WRITES,
+    STATS_USB_WRITE_FAILURES,
+    STATS_EMPTY_FRAMES,
+    STATS_FROZEN_FRAMES,
+    STATS_UNKNOWN_FRAMES,
+    STATS_RF_TRANSITIONS,
+    STATS_DONGLE_DISCONNECTIONS,
+    STATS_DONGLE_RECONNECTIONS,
+    STATS_COMMANDS_DROPPED,
+    STATS_LOG_DROPPED,
+    STATS_COUNTER_NUMBER,
+} STATS_COUNTER;
+
+/**
+ * Statistics of the driver. The counters are monotonic, the rates are
+ * per second over the last second. The frames are indexed by the low
+ * nibble of their header (0xFF for the pong frames).
+ */
+typedef struct {
+    double          uptime;
+    uint64_t        frames[16];
+    double          frame_rates[16];
+    uint64_t        counters[STATS_COUNTER_NUMBER];
+    double          rates[STATS_COUNTER_NUMBER];
+    unsigned int    pongs_pending;
+    unsigned int    pongs_lost_by_i2c;
+    unsigned int    pongs_lost_by_rf;
+} drv_stats_t;
+
+/**
+ * Measures of the RF link over the last ping bursts.
+ */
+typedef struct {
+    int             quality;
+    float           rf_loss;
+    float           i2c_loss;
+    float           latency;
+    unsigned int    pending;
+    int             bursts;
+} drv_link_quality_t;
+
+/**
+ * Record of the binary trace, see tux_trace.h for the types and payloads.
+ */
+typedef struct {
+    double          timestamp;
+    uint16_t        type;
+    uint16_t        thread;
+    uint32_t        arg;
+    uint8_t         data[8];
+} drv_trace_record_t;
+
+/**
+ * Value of a status at a monotonic time, from the history of the status.
+ */
+typedef struct {
+    double          timestamp;
+    int             intvalue;
+    float           floatvalue;
+    const char      *strvalue;
+} drv_status_sample_t;
+
+/**
+ * Consistent copy of all the statuses, indexed by SW_ID.
+ */
+typedef struct {
+    unsigned int    seq;
+    unsigned int    count;
+    struct {
+        int         value_fmt;
+        int         intvalue;
+        float       floatvalue;
+        const char  *strvalue;
+        double      lu_time;
+    } values[STATUS_SNAPSHOT_CAPACITY];
+} drv_status_snapshot_t;
+
 /**
  * Tokens structure
  */
@@ -218,18 +438,60 @@ extern void TuxDrv_LightLevel_update(void);
 extern const char *TuxDrv_StrError(TuxDrvError error_code);
 extern void TuxDrv_GetDescriptor(tux_descriptor_t *tux_desc);
 extern void TuxDrv_SetStatusCallback(drv_status_callback_t funct);
+extern void TuxDrv_SetStatusCallbackEx(drv_status_ex_callback_t funct);
+extern void TuxDrv_SetStatusSubscription(uint64_t mask);
+extern void TuxDrv_SetStatusCallbackMask(uint64_t mask);
+extern void TuxDrv_SetStatusCallbackExMask(uint64_t mask);
+extern void TuxDrv_SetStatusBatchCallback(drv_status_batch_callback_t funct);
+extern void TuxDrv_SetStatusBatchMask(uint64_t mask);
+extern TuxDrvError TuxDrv_SetStatusDispatchMode(int mode, int policy);
+extern int TuxDrv_DispatchStatusEvents(int max_events);
+extern TuxDrvError TuxDrv_GetStatusDispatchStats(
+    drv_status_dispatch_stats_t *stats);
+extern TuxDrvError TuxDrv_GetStats(drv_stats_t *stats);
+extern TuxDrvError TuxDrv_SetPingRate(float pings_per_second, int burst_size);
+extern TuxDrvError TuxDrv_GetLinkQuality(drv_link_quality_t *quality);
+extern TuxDrvError TuxDrv_StartTrace(const char *path);
+extern void TuxDrv_StopTrace(void);
+extern int TuxDrv_ReadTrace(drv_trace_record_t *records, int max);
+extern TuxDrvError TuxDrv_SetStatusEventFilter(int id, float threshold,
+    float hysteresis, float min_interval);
+extern TuxDrvError TuxDrv_GetStatusEventFilter(int id, float *threshold,
+    float *hysteresis, float *min_interval);
+extern void TuxDrv_SetStatusHistory(uint64_t mask);
+extern int TuxDrv_GetStatusHistory(int id, double since,
+    drv_status_sample_t *out, int max);
+extern TuxDrvError TuxDrv_StartStatusPublisher(const char *name);
+extern void TuxDrv_StopStatusPublisher(void);
+extern TuxDrvError TuxDrv_GetStatusSnapshot(drv_status_snapshot_t *snapshot);
 extern void TuxDrv_SetEndCycleCallback(drv_simple_callback_t funct);
 extern void TuxDrv_SetDongleConnectedCallback(drv_simple_callback_t funct);
 extern void TuxDrv_SetDongleDisconnectedCallback(drv_simple_callback_t funct);
 extern TuxDrvError TuxDrv_PerformCommand(double delay, char *cmd_str);
+extern TuxDrvError TuxDrv_QueueCommand(double delay, const char *cmd_str);
 extern void TuxDrv_ClearCommandStack(void);
 extern TuxDrvError TuxDrv_PerformMacroFile(char *file_path);
 extern TuxDrvError TuxDrv_PerformMacroText(char *macro);
+extern void TuxDrv_CancelMacroLoops(void);
+extern TuxDrvError TuxDrv_AnalyzeMacro(const char *macro, float max_duration,
+    macro_analysis_t *analysis);
+extern TuxDrvError TuxDrv_InjectStatusFrames(const unsigned char *frames,
+    int count);
+extern TuxDrvError TuxDrv_GetStackLockHistogram(unsigned int *histogram,
+    int size);
+extern TuxDrvError TuxDrv_SetTimeSource(drv_time_funct_t time_funct,
+    drv_sleep_funct_t sleep_funct);
+extern TuxDrvError TuxDrv_SetVirtualClock(double start_time);
+extern TuxDrvError TuxDrv_SetLanePolicy(int lane, int policy);
+extern TuxDrvError TuxDrv_GetLaneOccupancy(int lane, int *count,
+    unsigned int *dropped);
 extern TuxDrvError TuxDrv_SoundReflash(char *tracks);
+extern int TuxDrv_GetSoundReflashBadTrack(void);
 extern void TuxDrv_SetLogLevel(log_level_t level);
 extern void TuxDrv_SetLogTarget(log_target_t target);
 extern TuxDrvError TuxDrv_GetStatusName(int id, char* name);
 extern TuxDrvError TuxDrv_GetStatusId(char* name, int *id);
+extern TuxDrvError TuxDrv_GetStatusIdFromState(const char *state, int *id);
 extern TuxDrvError TuxDrv_GetStatusState(int id, char *state);
 extern TuxDrvError TuxDrv_GetStatusValue(int id, char *value);
 extern void TuxDrv_GetAllStatusState(char *state);
@@ -31,6 +31,10 @@ E_TUXDRV_INVALIDNAME                = E_TUXDRV_BEGIN + 6
 E_TUXDRV_INVALIDPARAMETER           = E_TUXDRV_BEGIN + 7
 E_TUXDRV_BUSY                       = E_TUXDRV_BEGIN + 8
 E_TUXDRV_WAVSIZEEXCEDED             = E_TUXDRV_BEGIN + 9
+E_TUXDRV_WAVNOTFOUND                = E_TUXDRV_BEGIN + 10
+E_TUXDRV_WAVNOTRIFF                 = E_TUXDRV_BEGIN + 11
+E_TUXDRV_WAVNODATA                  = E_TUXDRV_BEGIN + 12
+E_TUXDRV_WAVBADFORMAT               = E_TUXDRV_BEGIN + 13
 
 SW_ID_FLIPPERS_POSITION             = 0
 SW_ID_FLIPPERS_REMAINING_MVM        = 1
@@ -73,6 +77,7 @@ SW_ID_FLIPPERS_MOTOR_ON             = 37
 SW_ID_SPIN_LEFT_MOTOR_ON            = 38
 SW_ID_SPIN_RIGHT_MOTOR_ON           = 39
 SW_ID_FLASH_SOUND_COUNT             = 40
+SW_ID_SOUND_REFLASH_TRACK_PROGRESS  = 41
 
 SW_NAME_DRIVER = [
     "flippers_position",
@@ -115,7 +120,8 @@ SW_NAME_DRIVER = [
     "flippers_motor_on",
     "spin_left_motor_on",
     "spin_right_motor_on",
-    "sound_flash_count"
+    "sound_flash_count",
+    "sound_reflash_track_progress"
 ]
 
 LOG_LEVEL_DEBUG             = 0
@@ -0,0 +1,91 @@
+/*
+ * Tux Droid - Status shared memory
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_status_shm.h
+ * \brief Layout of the status shared memory and reader functions.
+ *
+ * The driver publishes its statuses in a POSIX shared memory segment at the
+ * end of each read cycle. The segment starts with a sequence counter which
+ * is odd while the driver writes it : a reader copies the segment and
+ * retries when the counter was odd or changed during the copy.
+ *
+ * The reader functions are in the libtuxstatusshm library, which does not
+ * depend on the driver.
+ */
+
+#ifndef _TUX_STATUS_SHM_H_
+#define _TUX_STATUS_SHM_H_
+
+#include <stdint.h>
+
+/** \brief Default name of the shared memory segment */
+#define TUX_STATUS_SHM_NAME             "/tuxdriver_status"
+/** \brief Magic number of an initialized segment ("TUXS") */
+#define TUX_STATUS_SHM_MAGIC            0x54555853
+/** \brief Version of the layout */
+#define TUX_STATUS_SHM_VERSION          2
+/** \brief Maximal number of statuses in the segment */
+#define TUX_STATUS_SHM_STATUSES         64
+/** \brief Size of the name of a status */
+#define TUX_STATUS_SHM_NAME_SIZE        48
+/** \brief Size of the value of a string status */
+#define TUX_STATUS_SHM_STR_SIZE         64
+/** \brief Number of frame types counted */
+#define TUX_STATUS_SHM_FRAME_TYPES      16
+
+/** \brief A status in the segment */
+typedef struct {
+    char        name[TUX_STATUS_SHM_NAME_SIZE]; /**< Name of the status */
+    int32_t     value_fmt; /**< Type of the value (ID_FMT) */
+    int32_t     intvalue; /**< Value of the bool, uint8 and int statuses */
+    float       floatvalue; /**< Value of the float statuses */
+    char        strvalue[TUX_STATUS_SHM_STR_SIZE]; /**< Value of the string
+                                                        statuses */
+    double      lu_time; /**< Time of the last update */
+} tux_status_shm_entry_t;
+
+/** \brief The shared memory segment */
+typedef struct {
+    uint32_t    magic; /**< TUX_STATUS_SHM_MAGIC once initialized */
+    uint32_t    version; /**< TUX_STATUS_SHM_VERSION */
+    volatile uint32_t seq; /**< Sequence counter, odd while written */
+    uint32_t    status_count; /**< Number of valid statuses */
+    uint32_t    publisher_pid; /**< Process of the driver which publishes */
+    uint32_t    reserved; /**< Must be 0 */
+    uint64_t    cycle_count; /**< Read cycles published */
+    uint64_t    frame_counts[TUX_STATUS_SHM_FRAME_TYPES]; /**< Status frames
+                                                  received, by header id */
+    double      publish_time; /**< Time of the last publication */
+    tux_status_shm_entry_t statuses[TUX_STATUS_SHM_STATUSES]; /**< Statuses
+                                                  indexed by SW_ID */
+} tux_status_shm_t;
+
+/** \brief Opaque reader handle */
+typedef struct tux_status_shm_reader tux_status_shm_reader_t;
+
+extern tux_status_shm_reader_t *tux_status_shm_open(const char *name);
+extern int tux_status_shm_read(tux_status_shm_reader_t *reader,
+    tux_status_shm_t *copy);
+extern int tux_status_shm_find(const tux_status_shm_t *copy,
+    const char *name);
+extern void tux_status_shm_close(tux_status_shm_reader_t *reader);
+
+#endif /* _TUX_STATUS_SHM_H_ */
@@ -0,0 +1,75 @@
+/*
+ * Tux Droid - Binary trace format
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_trace.h
+ * \brief Format of the binary trace of the driver.
+ *
+ * A trace file is a tux_trace_header_t followed by fixed-size
+ * tux_trace_record_t records, in the byte order of the host. The records
+ * are written in batches per thread, so they are only ordered by their
+ * timestamp within a thread.
+ */
+
+#ifndef _TUX_TRACE_H_
+#define _TUX_TRACE_H_
+
+#include <stdint.h>
+
+/** \brief Magic number of a trace file ("TXTR") */
+#define TUX_TRACE_MAGIC                 0x52545854
+/** \brief Version of the format */
+#define TUX_TRACE_VERSION               1
+
+/** \brief Types of the records */
+typedef enum {
+    TUX_TRACE_USB_WRITE = 1, /**< arg: 0 if written, data: raw frame (5) */
+    TUX_TRACE_USB_READ, /**< arg: status frames, data: id, RF state */
+    TUX_TRACE_FRAME_DECODED, /**< arg: changed fields, data: frame (4) */
+    TUX_TRACE_STATUS_EVENT, /**< arg: status id, data: seq, value */
+    TUX_TRACE_CMD_SCHEDULED, /**< arg: command, data: delay, submission */
+    TUX_TRACE_CMD_EXECUTED, /**< arg: command, data: submission */
+    TUX_TRACE_RECONNECT, /**< arg: captures of the dongle */
+    TUX_TRACE_LOST, /**< arg: records lost by the thread */
+} tux_trace_type_t;
+
+/** \brief Header of a trace file */
+typedef struct {
+    uint32_t    magic; /**< TUX_TRACE_MAGIC */
+    uint16_t    version; /**< TUX_TRACE_VERSION */
+    uint16_t    record_size; /**< sizeof(tux_trace_record_t) */
+    double      start_time; /**< Monotonic time of the start (seconds) */
+} tux_trace_header_t;
+
+/**
+ * \brief A record of the trace.
+ * The commands are coded as (group << 16) | (command << 8) | sub command.
+ * The values of the status events are an int32 or a float after the
+ * uint32 sequence number, the strings are not traced.
+ */
+typedef struct {
+    double      timestamp; /**< Monotonic time (seconds) */
+    uint16_t    type; /**< tux_trace_type_t */
+    uint16_t    thread; /**< Index of the thread, reused after its exit */
+    uint32_t    arg; /**< Main argument */
+    uint8_t     data[8]; /**< Payload */
+} tux_trace_record_t;
+
+#endif /* _TUX_TRACE_H_ */
@@ -27,7 +27,17 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <time.h>
+#ifdef WIN32
+#   include <windows.h>
+#else
+#   include <unistd.h>
+#endif
+
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
 
 #include "log.h"
 
@@ -37,12 +47,23 @@
 #else
 #   define LOG_FILE  "/var/log/tuxdroid/libtuxdriver.log"
 #endif
+/** Name of the previous log file, after a rotation */
+#define LOG_FILE_OLD  LOG_FILE ".1"
 
 /** All logged messages are prefixed with this text */
 #define LOG_PREFIX  "libtuxdriver"
 
+/** Maximal size of a message */
+#define LOG_LINE_SIZE  1024
+/** Messages waiting for the writer thread, must be a power of 2 */
+#define LOG_RING_SIZE  256
+/** Size of the log file which triggers a rotation */
+#define LOG_MAX_FILE_SIZE  (1024 * 1024)
+/** Sleep of the writer thread when the ring is empty (milliseconds) */
+#define LOG_WRITER_PERIOD  50
+
 /** Current logging level */
-static log_level_t current_level = LOG_LEVEL_INFO;
+log_level_t log_current_level = LOG_LEVEL_INFO;
 
 /** Logging level names */
 static const char *level_names[] =
@@ -57,16 +78,274 @@ static const char *level_names[] =
 /** Current logging target */
 static log_target_t log_target = LOG_TARGET_SHELL;
 
-/** Log file for target LOG_TARGET_TUX */
+/** Log file for target LOG_TARGET_TUX, open while the log is opened */
 static FILE *log_file;
 
+/** Size of the log file */
+static long log_file_size;
+
 /** Whether the log has been opened */
 static bool log_opened;
 
+/**
+ * Slot of the message ring.
+ * The sequence number of a slot tells who owns it: a producer can fill it
+ * when it equals the enqueue position, the writer can read it when it
+ * equals the dequeue position plus one.
+ */
+typedef struct
+{
+    volatile unsigned int seq;
+    log_level_t level;
+    char text[LOG_LINE_SIZE];
+} log_slot_t;
+
+/** Messages waiting for the writer thread */
+static log_slot_t ring[LOG_RING_SIZE];
+static volatile unsigned int enqueue_pos;
+static volatile unsigned int dequeue_pos;
+
+/** Messages lost because the ring was full */
+static volatile unsigned int dropped_count;
+/** Dropped messages already reported in the log */
+static unsigned int dropped_reported;
+
+/** Whether the messages go through the writer thread */
+static volatile bool log_async;
+
+#ifdef USE_MUTEX
+static thread_t writer_thread;
+static volatile bool writer_running;
+#endif
+
+/**
+ * \brief Sleep the writer.
+ * \param ms Delay in milliseconds.
+ */
+static void
+writer_sleep(int ms)
+{
+#ifdef WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/**
+ * \brief Open the log file, keeping the previous one when it is rotated.
+ * \param mode Opening mode of the file.
+ * \return true if successfull, false otherwise.
+ */
+static bool
+open_log_file(const char *mode)
+{
+    log_file = fopen(LOG_FILE, mode);
+    if (log_file == NULL)
+    {
+        return false;
+    }
+    fseek(log_file, 0, SEEK_END);
+    log_file_size = ftell(log_file);
+
+    return true;
+}
+
+/**
+ * \brief Start a new log file when the current one is too big.
+ */
+static void
+rotate_log_file(void)
+{
+    if (log_file_size < LOG_MAX_FILE_SIZE)
+    {
+        return;
+    }
+
+    fclose(log_file);
+    remove(LOG_FILE_OLD);
+    rename(LOG_FILE, LOG_FILE_OLD);
+    open_log_file("w");
+}
+
+/**
+ * \brief Write a message to the target of the log.
+ * \param at_level Level of the message.
+ * \param text Text of the message.
+ */
+static void
+write_log_text(log_level_t at_level, const char *text)
+{
+    int r;
+
+    switch (log_target)
+    {
+    case LOG_TARGET_TUX:
+        if (log_file == NULL)
+        {
+            return;
+        }
+        r = fprintf(log_file, "%s\n", text);
+        if (r > 0)
+        {
+            log_file_size += r;
+        }
+        rotate_log_file();
+        break;
+
+    case LOG_TARGET_SHELL:
+        if (at_level == LOG_LEVEL_WARNING || at_level == LOG_LEVEL_ERROR)
+        {
+            fprintf(stderr, "%s: %s\n", LOG_PREFIX, text);
+        }
+        else
+        {
+            fprintf(stdout, "%s: %s\n", LOG_PREFIX, text);
+        }
+        break;
+    }
+}
+
+/**
+ * \brief Flush the target of the log.
+ */
+static void
+flush_log(void)
+{
+    switch (log_target)
+    {
+    case LOG_TARGET_TUX:
+        if (log_file != NULL)
+        {
+            fflush(log_file);
+        }
+        break;
+
+    case LOG_TARGET_SHELL:
+        fflush(stdout);
+        fflush(stderr);
+        break;
+    }
+}
+
+/**
+ * \brief Write all the messages of the ring.
+ * \return The number of messages written.
+ */
+static int
+drain_ring(void)
+{
+    char text[64];
+    log_slot_t *slot;
+    unsigned int dropped;
+    int count = 0;
+
+    for (;;)
+    {
+        slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (slot->seq != dequeue_pos + 1)
+        {
+            break;
+        }
+        __sync_synchronize();
+        if (slot->text[0] != '\0')
+        {
+            write_log_text(slot->level, slot->text);
+        }
+        __sync_synchronize();
+        slot->seq = dequeue_pos + LOG_RING_SIZE;
+        dequeue_pos++;
+        count++;
+    }
+
+    dropped = dropped_count;
+    if (dropped != dropped_reported)
+    {
+        snprintf(text, sizeof(text), "%s: %u messages dropped",
+            level_names[LOG_LEVEL_WARNING], dropped - dropped_reported);
+        write_log_text(LOG_LEVEL_WARNING, text);
+        dropped_reported = dropped;
+        count++;
+    }
+
+    if (count > 0)
+    {
+        flush_log();
+    }
+
+    return count;
+}
+
+#ifdef USE_MUTEX
+/**
+ * \brief Loop of the writer thread.
+ * The messages are written in batches, then the thread sleeps until the
+ * next ones.
+ */
+static void *
+writer_loop(void *param)
+{
+    (void)param;
+
+    while (writer_running)
+    {
+        if (drain_ring() == 0)
+        {
+            writer_sleep(LOG_WRITER_PERIOD);
+        }
+    }
+    drain_ring();
+
+    return 0;
+}
+#endif
+
+/**
+ * \brief Start to send the messages to the writer thread.
+ */
+static void
+start_writer(void)
+{
+#ifdef USE_MUTEX
+    unsigned int i;
+
+    for (i = 0; i < LOG_RING_SIZE; i++)
+    {
+        ring[i].seq = i;
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    writer_running = true;
+    thread_create(writer_thread, writer_loop, NULL);
+    log_async = true;
+#endif
+}
+
+/**
+ * \brief Write the messages left and stop the writer thread.
+ */
+static void
+stop_writer(void)
+{
+#ifdef USE_MUTEX
+    if (!log_async)
+    {
+        return;
+    }
+    log_async = false;
+    writer_running = false;
+    thread_wait_close(writer_thread);
+    thread_delete(writer_thread);
+#endif
+}
+
 /**
  * \brief Open the log.
  * \param target Logging target.
  * \return true if successfull, false otherwise.
+ *
+ * The messages are then written by a background thread, so the callers
+ * never wait for the target.
  */
 bool
 log_open(log_target_t target)
@@ -79,13 +358,10 @@ log_open(log_target_t target)
     switch (target)
     {
     case LOG_TARGET_TUX:
-        log_file = fopen(LOG_FILE, "w");
-        if (log_file == NULL)
+        if (!open_log_file("w"))
         {
             return false;
         }
-        fclose(log_file);
-        log_file = NULL;
         break;
 
     case LOG_TARGET_SHELL:
@@ -94,6 +370,7 @@ log_open(log_target_t target)
 
     log_target = target;
     log_opened = true;
+    start_writer();
 
     return true;
 }
@@ -109,9 +386,16 @@ log_close(void)
         return;
     }
 
+    stop_writer();
+
     switch (log_target)
     {
     case LOG_TARGET_TUX:
+        if (log_file != NULL)
+        {
+            fclose(log_file);
+            log_file = NULL;
+        }
         break;
 
     case LOG_TARGET_SHELL:
@@ -122,20 +406,14 @@ log_close(void)
 }
 
 /**
- * \brief Write text in the log.
- * \param text Text to write.
+ * \brief Get the number of messages lost because the writer thread was
+ * late.
+ * \return The number of messages dropped since the start.
  */
-static void
-write_log_text(char *text)
+unsigned int
+log_get_dropped(void)
 {
-    log_file = fopen(LOG_FILE, "a");
-    if (log_file == NULL)
-    {
-        return;
-    }
-    fprintf(log_file, "%s\n", text);
-    fclose(log_file);
-    log_file = NULL;
+    return dropped_count;
 }
 
 /**
@@ -146,7 +424,7 @@ void
 log_set_level(log_level_t new_level)
 {
     assert(new_level >= LOG_LEVEL_DEBUG && new_level <= LOG_LEVEL_NONE);
-    current_level = new_level;
+    log_current_level = new_level;
 }
 
 /**
@@ -156,43 +434,69 @@ log_set_level(log_level_t new_level)
 log_level_t
 log_get_level(void)
 {
-    return current_level;
+    return log_current_level;
 }
 
 /**
- * \brief Log formatted message at the specified level.
- *
- * \param at_level Level to log the message at.
- * \param fmt Message format.
- * \param ... Optional message data.
- *
- * If the priority of the specifed level is lower than the priority
- * of the current logging level, the message is silently dropped.
- *
- * \return true if successful, false otherwise.
+ * \brief Take a free slot of the ring.
+ * \return The slot, NULL if the ring is full.
  */
-bool
-log_text(log_level_t at_level, const char *fmt, ...)
+static log_slot_t *
+claim_slot(void)
 {
-    char text[1024], *p = text;
-    size_t size = sizeof(text);
-    time_t now;
-    va_list al;
-    int r;
+    log_slot_t *slot;
+    unsigned int pos;
 
-    /* No need for the log to be 'opened' when logging to std{out,err} */
-    if (log_target != LOG_TARGET_SHELL && !log_opened)
+    for (;;)
     {
-        return false;
+        pos = enqueue_pos;
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        if (slot->seq != pos)
+        {
+            if ((int)(slot->seq - pos) < 0)
+            {
+                /* The writer did not release this slot yet */
+                return NULL;
+            }
+            /* Another producer took it */
+            continue;
+        }
+        if (__sync_bool_compare_and_swap(&enqueue_pos, pos, pos + 1))
+        {
+            return slot;
+        }
     }
+}
 
-    /* Logging at level NONE has no sense */
-    assert(at_level >= LOG_LEVEL_DEBUG && at_level < LOG_LEVEL_NONE);
+/**
+ * \brief Give a filled slot to the writer thread.
+ * \param slot Slot taken by claim_slot.
+ */
+static void
+publish_slot(log_slot_t *slot)
+{
+    unsigned int pos = slot->seq;
 
-    if (at_level < current_level)
-    {
-        return true;
-    }
+    __sync_synchronize();
+    slot->seq = pos + 1;
+}
+
+/**
+ * \brief Format a message.
+ * \param text Output buffer of LOG_LINE_SIZE bytes.
+ * \param at_level Level of the message.
+ * \param fmt Message format.
+ * \param al Message data.
+ * \return true if successful, false otherwise.
+ */
+static bool
+format_log_text(char *text, log_level_t at_level, const char *fmt,
+    va_list al)
+{
+    char *p = text;
+    size_t size = LOG_LINE_SIZE;
+    time_t now;
+    int r;
 
     /* Add date & time when LOG_TARGET_TUX */
     if (log_target == LOG_TARGET_TUX)
@@ -225,30 +529,84 @@ log_text(log_level_t at_level, const char *fmt, ...)
         size -= r;
     }
 
-    va_start(al, fmt);
     r = vsnprintf(p, size, fmt, al);
-    va_end(al);
     if (r < 0)
     {
         return false;
     }
 
-    switch (log_target)
+    return true;
+}
+
+/**
+ * \brief Log formatted message at the specified level.
+ *
+ * \param at_level Level to log the message at.
+ * \param fmt Message format.
+ * \param ... Optional message data.
+ *
+ * If the priority of the specifed level is lower than the priority
+ * of the current logging level, the message is silently dropped.
+ * When the log is opened, the message is formatted in the ring and
+ * written later by the writer thread; it is dropped if the ring is full.
+ *
+ * \return true if successful, false otherwise.
+ */
+bool
+log_text(log_level_t at_level, const char *fmt, ...)
+{
+    char text[LOG_LINE_SIZE];
+    log_slot_t *slot;
+    va_list al;
+    bool ret;
+
+    /* No need for the log to be 'opened' when logging to std{out,err} */
+    if (log_target != LOG_TARGET_SHELL && !log_opened)
     {
-    case LOG_TARGET_TUX:
-        write_log_text(text);
-        break;
+        return false;
+    }
 
-    case LOG_TARGET_SHELL:
-        if (at_level == LOG_LEVEL_WARNING || at_level == LOG_LEVEL_ERROR)
+    /* Logging at level NONE has no sense */
+    assert(at_level >= LOG_LEVEL_DEBUG && at_level < LOG_LEVEL_NONE);
+
+    if (at_level < log_current_level)
+    {
+        return true;
+    }
+
+    if (log_async)
+    {
+        slot = claim_slot();
+        if (slot == NULL)
         {
-            fprintf(stderr, "%s: %s\n", LOG_PREFIX, text);
+            __sync_fetch_and_add(&dropped_count, 1);
+            return false;
         }
-        else
+        slot->level = at_level;
+        va_start(al, fmt);
+        ret = format_log_text(slot->text, at_level, fmt, al);
+        va_end(al);
+        if (!ret)
         {
-            fprintf(stdout, "%s: %s\n", LOG_PREFIX, text);
+            slot->text[0] = '\0';
         }
-        break;
+        publish_slot(slot);
+
+        return ret;
+    }
+
+    va_start(al, fmt);
+    ret = format_log_text(text, at_level, fmt, al);
+    va_end(al);
+    if (!ret)
+    {
+        return false;
+    }
+
+    write_log_text(at_level, text);
+    if (log_target == LOG_TARGET_TUX)
+    {
+        flush_log();
     }
 
     return true;
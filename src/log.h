@@ -38,6 +38,7 @@ typedef enum log_target
 
 extern bool log_open(log_target_t target);
 extern void log_close(void);
+extern unsigned int log_get_dropped(void);
 
 /** \brief Logging levels, in increasing priorities */
 typedef enum log_level
@@ -49,15 +50,44 @@ typedef enum log_level
     LOG_LEVEL_NONE /**< Level None */
 } log_level_t;
 
+/**
+ * \brief Lowest level compiled in.
+ * The calls below this level are removed by the compiler, for example
+ * with -DLOG_MIN_LEVEL=LOG_LEVEL_INFO.
+ */
+#ifndef LOG_MIN_LEVEL
+#   define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+/** \brief Current logging level, use log_set_level to change it */
+extern log_level_t log_current_level;
+
 extern void log_set_level(log_level_t new_level);
 extern log_level_t log_get_level(void);
 
 extern bool log_text(log_level_t at_level, const char *fmt, ...)
     __attribute__((format(printf, 2, 3)));
 
-#define log_debug(fmt, ...)  log_text(LOG_LEVEL_DEBUG, (fmt), ## __VA_ARGS__)
-#define log_info(fmt, ...)  log_text(LOG_LEVEL_INFO, (fmt), ## __VA_ARGS__)
-#define log_warning(fmt, ...)  log_text(LOG_LEVEL_WARNING, (fmt), ## __VA_ARGS__)
-#define log_error(fmt, ...)  log_text(LOG_LEVEL_ERROR, (fmt), ## __VA_ARGS__)
+/**
+ * \brief Check if a message of a level would be logged.
+ * Use it to skip the computations only needed by a message.
+ */
+#define log_enabled(level) \
+    (((level) >= LOG_MIN_LEVEL) && ((level) >= log_current_level))
+
+/* The arguments are only evaluated when the level is enabled */
+#define log_at(level, fmt, ...) \
+    do \
+    { \
+        if (log_enabled(level)) \
+        { \
+            log_text((level), (fmt), ## __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define log_debug(fmt, ...)  log_at(LOG_LEVEL_DEBUG, (fmt), ## __VA_ARGS__)
+#define log_info(fmt, ...)  log_at(LOG_LEVEL_INFO, (fmt), ## __VA_ARGS__)
+#define log_warning(fmt, ...)  log_at(LOG_LEVEL_WARNING, (fmt), ## __VA_ARGS__)
+#define log_error(fmt, ...)  log_at(LOG_LEVEL_ERROR, (fmt), ## __VA_ARGS__)
 
 #endif /* __LOG_H__ */
@@ -30,6 +30,17 @@
 #   define semaphore_lock(sema)             WaitForSingleObject((sema), INFINITE)
 #   define semaphore_unlock(sema)           ReleaseSemaphore((sema), 1, NULL)
 #   define semaphore_delete(sema)           CloseHandle(sema)
+#   define cond_t                           CONDITION_VARIABLE
+#   define cond_init(cond)                  InitializeConditionVariable(& cond)
+#   define cond_wait(cond, mutex)           SleepConditionVariableCS(& cond, & mutex, INFINITE)
+#   define cond_signal(cond)                WakeConditionVariable(& cond)
+#   define cond_broadcast(cond)             WakeAllConditionVariable(& cond)
+#   define cond_delete(cond)
+#   define thread_local_t                   __declspec(thread)
+#   define thread_key_t                     DWORD
+#   define thread_key_callback_t            void __stdcall
+#   define thread_key_create(key, dtor)     ((key) = FlsAlloc((PFLS_CALLBACK_FUNCTION)(dtor)))
+#   define thread_key_set(key, value)       FlsSetValue((key), (value))
 #else
 #   include <pthread.h>
 #   define callback_t                       void *
@@ -48,6 +59,17 @@
 #   define semaphore_lock(sema)             sem_wait((sema))
 #   define semaphore_unlock(sema)           sem_post((sema))
 #   define semaphore_delete(sema)           sem_destroy((sema));  delete ((sema))
+#   define cond_t                           pthread_cond_t
+#   define cond_init(cond)                  pthread_cond_init((&cond), NULL)
+#   define cond_wait(cond, mutex)           pthread_cond_wait((&cond), (&mutex))
+#   define cond_signal(cond)                pthread_cond_signal((&cond))
+#   define cond_broadcast(cond)             pthread_cond_broadcast((&cond))
+#   define cond_delete(cond)                pthread_cond_destroy((&cond))
+#   define thread_local_t                   __thread
+#   define thread_key_t                     pthread_key_t
+#   define thread_key_callback_t            void
+#   define thread_key_create(key, dtor)     pthread_key_create((&key), (dtor))
+#   define thread_key_set(key, value)       pthread_setspecific((key), (value))
 #endif
 
 #endif
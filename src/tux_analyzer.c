@@ -0,0 +1,155 @@
+/*
+ * Tux Droid - Macro analyzer
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_analyzer.c
+ * \brief Macro analyzer functions.
+ * \ingroup command_parser
+ *
+ * A macro is analyzed by running the real parser and scheduler on a virtual
+ * time source while the usb writes are captured. The wait which follows each
+ * send gives the air time of a frame. Each cycle of the simulated read loop
+ * costs the status read frame, then the frames emitted by the due commands,
+ * and lasts at least TUX_READ_LOOP_INTERVAL.
+ */
+
+#include <string.h>
+
+#include "tux_analyzer.h"
+#include "tux_cmd_parser.h"
+#include "tux_usb.h"
+
+/** \brief Frames sent in the current cycle */
+static unsigned int cycle_frames = 0;
+/** \brief Analysis being filled */
+static macro_analysis_t *current_analysis = NULL;
+
+/**
+ * \brief Account a frame written during an analysis.
+ * \param data Frame data.
+ */
+static void
+on_captured_frame(const unsigned char *data)
+{
+    unsigned int second;
+    double now;
+
+    if (current_analysis == NULL)
+    {
+        /* Frames of the stacks cleanup */
+        return;
+    }
+
+    now = get_time();
+    second = (unsigned int)now;
+    if (second < ANALYSIS_SECONDS)
+    {
+        current_analysis->fps[second]++;
+        if (second >= current_analysis->seconds)
+        {
+            current_analysis->seconds = second + 1;
+        }
+    }
+    current_analysis->frame_count++;
+    cycle_frames++;
+    /* The frame ends after the wait of the send */
+    current_analysis->duration = (float)(now + ANALYSIS_FRAME_TIME);
+}
+
+/**
+ * \brief Analyze a macro without device.
+ * \param macro_str Macro string.
+ * \param max_duration Maximal simulated duration (seconds), endless loops
+ * are stopped there.
+ * \param analysis Output analysis.
+ * \return The error result, E_TUXDRV_BUSY if the dongle is connected.
+ *
+ * The command stacks are cleared before and after the analysis.
+ */
+LIBLOCAL TuxDrvError
+tux_analyzer_run_macro(const char *macro_str, float max_duration,
+        macro_analysis_t *analysis)
+{
+    TuxDrvError ret;
+    unsigned int conflicts;
+    double cycle_start;
+    time_source_t saved_time_funct;
+    sleep_funct_t saved_sleep_funct;
+
+    if ((macro_str == NULL) || (analysis == NULL) || (max_duration <= 0.0))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+    if (tux_usb_connected() || (current_analysis != NULL))
+    {
+        return E_TUXDRV_BUSY;
+    }
+
+    memset(analysis, 0, sizeof(macro_analysis_t));
+    get_time_source(&saved_time_funct, &saved_sleep_funct);
+    set_virtual_time_source(0.0);
+    tux_usb_set_write_capture(on_captured_frame);
+    tux_cmd_parser_clear_delay_commands();
+
+    current_analysis = analysis;
+    conflicts = tux_cmd_parser_get_conflicts();
+
+    ret = tux_cmd_parser_parse_macro(macro_str);
+    while ((ret == E_TUXDRV_NOERROR) && (tux_cmd_parser_get_pending() > 0))
+    {
+        if (get_time() >= max_duration)
+        {
+            analysis->truncated = true;
+            break;
+        }
+
+        cycle_start = get_time();
+        cycle_frames = 0;
+        /* Status read of the cycle */
+        wait_seconds(ANALYSIS_FRAME_TIME);
+        tux_cmd_parser_delay_stack_perform();
+
+        if (cycle_frames > analysis->peak_burst)
+        {
+            analysis->peak_burst = cycle_frames;
+            analysis->peak_burst_time = (float)cycle_start;
+        }
+        /* Half a frame of margin for the rounding of the virtual time */
+        if (get_time() > (cycle_start + TUX_READ_LOOP_INTERVAL +
+                          ANALYSIS_FRAME_TIME / 2))
+        {
+            analysis->overrun_count++;
+        }
+        else
+        {
+            /* The rest of the cycle */
+            wait_seconds(cycle_start + TUX_READ_LOOP_INTERVAL - get_time());
+        }
+    }
+
+    analysis->conflict_count = tux_cmd_parser_get_conflicts() - conflicts;
+    current_analysis = NULL;
+
+    tux_cmd_parser_clear_delay_commands();
+    tux_usb_set_write_capture(NULL);
+    set_time_source(saved_time_funct, saved_sleep_funct);
+
+    return ret;
+}
@@ -0,0 +1,56 @@
+/*
+ * Tux Droid - Macro analyzer
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_analyzer.h
+ * \brief Macro analyzer header.
+ * \ingroup command_parser
+ */
+
+#ifndef _TUX_ANALYZER_H_
+#define _TUX_ANALYZER_H_
+
+#include <stdbool.h>
+
+#include "tux_error.h"
+
+/** \brief Maximal number of seconds covered by the frames rate report */
+#define ANALYSIS_SECONDS 600
+/** \brief Air time of a frame sent to the dongle */
+#define ANALYSIS_FRAME_TIME 0.01
+
+/** \brief Result of a macro analysis */
+typedef struct {
+    float duration; /**< Time of the end of the last frame (seconds) */
+    unsigned int frame_count; /**< Number of frames sent */
+    unsigned int peak_burst; /**< Maximal number of frames in a cycle */
+    float peak_burst_time; /**< Start time of the peak cycle */
+    unsigned int overrun_count; /**< Cycles longer than the read loop
+                                     interval because of their frames */
+    unsigned int conflict_count; /**< Commands started on a busy lane */
+    bool truncated; /**< The analysis stopped before the macro end */
+    unsigned int seconds; /**< Number of valid entries in fps */
+    unsigned int fps[ANALYSIS_SECONDS]; /**< Frames sent in each second */
+} macro_analysis_t;
+
+extern TuxDrvError tux_analyzer_run_macro(const char *macro_str,
+    float max_duration, macro_analysis_t *analysis);
+
+#endif /* _TUX_ANALYZER_H_ */
@@ -41,17 +41,8 @@ typedef enum
     EMPTY /**< Battery level empty */
 } battery_state_t;
 
-/**
- * REPORTING_DELTA is the treshold value for changes;
- * changes smaller than this value are not reported
- * might become a controllable parameter in the future
- */
-#define REPORTING_DELTA 100
-
 /** Current battery state */
 static battery_state_t battery_state = EMPTY;
-/** Current battery state for event */
-static int last_level_for_event = 0;
 
 /**
  * \brief Update the status of the battery voltage.
@@ -62,7 +53,6 @@ tux_battery_update_level(void)
     int new_level = 0;
     int adc_value;
     char *new_state_str = "";
-    int delta;
 
     /* Get the current battery level from adc and convert it to mV */
     adc_value = (hw_status_table.battery.high_level << 8);
@@ -71,58 +61,46 @@ tux_battery_update_level(void)
     /* 7.467 = 0.00322 * 2.319 * 1000 no idea where the first two are from
      * 1000 is to go to mV */
 
-    /* Get the difference between last and new level */
-    delta = new_level - last_level_for_event;
+    /* The event filter of the status holds the small changes, the level
+     * is not reported while the motors run */
+    tux_sw_status_set_intvalue(SW_ID_BATTERY_LEVEL, new_level,
+        !hw_status_table.battery.motors_state);
 
-    /* If the delta threshold is reached */
-    if ((delta > REPORTING_DELTA) || (delta < -REPORTING_DELTA))
-    {
-        last_level_for_event = new_level;
-
-        /* Update directly the SW_ID_BATTERY_LEVEL status if motors off */
-        if (!hw_status_table.battery.motors_state)
-        {
-            tux_sw_status_set_intvalue(SW_ID_BATTERY_LEVEL, new_level, true);
-        }
+    /* The state follows the stored level at every update, its status only
+     * makes an event when it changes */
 
-        /* Battery level full */
-        if (new_level >= TUX_BATTERY_FULL_VALUE)
+    /* Battery level full */
+    if (new_level >= TUX_BATTERY_FULL_VALUE)
+    {
+        new_state_str = STRING_VALUE_FULL;
+        battery_state = FULL;
+    }
+    else
+    {
+        /* Battery level high */
+        if ((new_level < TUX_BATTERY_FULL_VALUE) &&
+            (new_level >= TUX_BATTERY_HIGH_VALUE))
         {
-            new_state_str = STRING_VALUE_FULL;
-            battery_state = FULL;
+            new_state_str = STRING_VALUE_HIGH;
+            battery_state = HIGH;
         }
         else
         {
-            /* Battery level high */
-            if ((new_level < TUX_BATTERY_FULL_VALUE) &&
-                (new_level >= TUX_BATTERY_HIGH_VALUE))
+            /* Battery level low */
+            if ((new_level < TUX_BATTERY_HIGH_VALUE) &&
+                (new_level >= TUX_BATTERY_LOW_VALUE))
             {
-                new_state_str = STRING_VALUE_HIGH;
-                battery_state = HIGH;
+                new_state_str = STRING_VALUE_LOW;
+                battery_state = LOW;
             }
             else
             {
-                /* Battery level low */
-                if ((new_level < TUX_BATTERY_HIGH_VALUE) &&
-                    (new_level >= TUX_BATTERY_LOW_VALUE))
-                {
-                    new_state_str = STRING_VALUE_LOW;
-                    battery_state = LOW;
-                }
-                else
-                {
-                    /* Battery level empty */
-                    new_state_str = STRING_VALUE_EMPTY;
-                    battery_state = EMPTY;
-                }
+                /* Battery level empty */
+                new_state_str = STRING_VALUE_EMPTY;
+                battery_state = EMPTY;
             }
         }
-        /* Update the SW_ID_BATTERY_STATE status */
-        tux_sw_status_set_strvalue(SW_ID_BATTERY_STATE, new_state_str, true);
-    }
-    else
-    {
-        /* Update the SW_ID_BATTERY_LEVEL status */
-        tux_sw_status_set_intvalue(SW_ID_BATTERY_LEVEL, new_level, false);
     }
+    /* Update the SW_ID_BATTERY_STATE status */
+    tux_sw_status_set_strvalue(SW_ID_BATTERY_STATE, new_state_str, true);
 }
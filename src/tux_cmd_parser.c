@@ -42,7 +42,9 @@
 #include "tux_mouth.h"
 #include "tux_sound_flash.h"
 #include "tux_spinning.h"
+#include "tux_stats.h"
 #include "tux_sw_status.h"
+#include "tux_tracer.h"
 #include "tux_types.h"
 #include "tux_usb.h"
 #include "tux_user_inputs.h"
@@ -63,24 +65,168 @@ static cmd_stack_t sys_cmd_stack;
 #ifdef USE_MUTEX
 static mutex_t __stack_mutex;
 static mutex_t __macro_mutex;
+static mutex_t __exec_mutex;
 #endif
+/** \brief Flag which indicates if the mutexes are initialized */
+static bool cmd_parser_ready = false;
 /** \brief Flag which indicates if the parser is enabled */
 static bool cmd_parser_enable = true;
+/** \brief Policy of each command lane */
+static cmd_lane_policy_t lane_policy[CMD_LANE_NUMBER];
+/** \brief Number of commands dropped by each lane, protected by the stack
+ * lock */
+static unsigned int lane_dropped[CMD_LANE_NUMBER];
+/** \brief Identifier of the last submission (command or macro) */
+static unsigned int last_submission = 0;
+
+/** \brief Bit of a lane in a lanes mask */
+#define LANE_BIT(lane) (1U << (lane))
+
+#define NRLOOPS 16
+#define NRLOOPCMDS 64
+
+/** \brief States of a macro loop slot */
+typedef enum {
+    LOOP_FREE = 0, /**< Slot is unused */
+    LOOP_COMPILING, /**< Block is being parsed */
+    LOOP_ARMED, /**< Block is scheduled */
+} loop_state_t;
+
+/** \brief Compiled REPEAT/LOOP block of a macro */
+typedef struct {
+    delay_cmd_t cmd_list[NRLOOPCMDS]; /**< Timeline, timeout is the offset
+                                           in the block, sorted */
+    int cmd_count; /**< Number of commands in the timeline */
+    int cursor; /**< Next command of the timeline to execute */
+    double start_time; /**< Start time of the current iteration */
+    float period; /**< Time between two iterations */
+    int remaining; /**< Iterations left, -1 for an endless loop */
+    loop_state_t state; /**< Slot state */
+} cmd_loop_t;
+
+/** \brief Parsing context of a macro */
+typedef struct {
+    unsigned int submission; /**< Submission of the macro */
+    cmd_loop_t *loop; /**< Block being compiled, NULL outside a block */
+    float loop_offset; /**< Offset of the block being compiled */
+} macro_ctx_t;
+
+/** \brief Macro loops */
+static cmd_loop_t loops[NRLOOPS];
+
+#define NRDUECMDS (2 * NRCMDS + NRLOOPS * NRLOOPCMDS)
+
+/** \brief Commands collected to be executed outside the stack lock */
+static struct {
+    delay_cmd_t cmd_list[NRDUECMDS]; /**< Commands in execution order */
+    int cmd_count; /**< Number of commands */
+} due_cmds;
+
+#define LOCK_HISTOGRAM_SIZE 16
+
+/** \brief Hold times of the stack lock, log2 of microseconds */
+static unsigned int lock_histogram[LOCK_HISTOGRAM_SIZE];
+/** \brief Time of the last stack lock */
+static double lock_time = 0.0;
+/** \brief Number of commands started on a busy lane */
+static unsigned int lane_conflicts = 0;
+
+/**
+ * \brief Lock the command stacks.
+ */
+static void
+stack_lock(void)
+{
+#ifdef USE_MUTEX
+    mutex_lock(__stack_mutex);
+#endif
+    lock_time = get_system_time();
+}
 
 /**
- * \brief Initialize the parser.
+ * \brief Unlock the command stacks and record the hold time.
+ */
+static void
+stack_unlock(void)
+{
+    unsigned long held;
+    int bucket = 0;
+
+    held = (unsigned long)((get_system_time() - lock_time) * 1000000.0);
+    while ((held > 1) && (bucket < (LOCK_HISTOGRAM_SIZE - 1)))
+    {
+        held >>= 1;
+        bucket++;
+    }
+    lock_histogram[bucket]++;
+#ifdef USE_MUTEX
+    mutex_unlock(__stack_mutex);
+#endif
+}
+
+/**
+ * \brief Initialize the parser, or empty the stacks when the dongle is
+ * connected again.
+ *
+ * Other threads can use the parser meanwhile, so the mutexes are only
+ * initialized once and the stacks are emptied under the locks. The blocks
+ * of the macros being parsed are kept.
  */
 LIBLOCAL void
 tux_cmd_parser_init(void)
 {
+    int i;
+
+    if (!cmd_parser_ready)
+    {
+        memset(&user_cmd_stack, 0, sizeof(cmd_stack_t));
+        memset(&sys_cmd_stack, 0, sizeof(cmd_stack_t));
+        memset(&loops, 0, sizeof(loops));
+#ifdef USE_MUTEX
+        mutex_init(__stack_mutex);
+        mutex_init(__macro_mutex);
+        mutex_init(__exec_mutex);
+#endif
+        cmd_parser_ready = true;
+        return;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__exec_mutex);
+#endif
+    stack_lock();
     memset(&user_cmd_stack, 0, sizeof(cmd_stack_t));
     memset(&sys_cmd_stack, 0, sizeof(cmd_stack_t));
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        if (loops[i].state == LOOP_ARMED)
+        {
+            loops[i].state = LOOP_FREE;
+        }
+    }
+    stack_unlock();
 #ifdef USE_MUTEX
-    mutex_init(__stack_mutex);
-    mutex_init(__macro_mutex);
+    mutex_unlock(__exec_mutex);
 #endif
 }
 
+/**
+ * \brief Add a command to the commands to execute.
+ * \param cmd Command to add.
+ * \return The added copy.
+ *
+ * The stack mutex must be locked.
+ */
+static delay_cmd_t *
+collect_command(const delay_cmd_t *cmd)
+{
+    delay_cmd_t *ret = &due_cmds.cmd_list[due_cmds.cmd_count];
+
+    *ret = *cmd;
+    due_cmds.cmd_count++;
+    return ret;
+}
+
 /**
  * \brief Enabling/disabling the parser.
  * \param value Flag value.
@@ -123,6 +269,10 @@ tux_cmd_parser_get_tokens(const char *src_str, tokens_t *toks,
             if (pnext)
             {
                 len = pnext - p;
+                if (len >= TOKENSIZE)
+                {
+                    len = TOKENSIZE - 1;
+                }
                 strncpy((*toks)[cnt], p, len);
                 ((*toks)[cnt])[len] = 0;
                 cnt++;
@@ -134,7 +284,8 @@ tux_cmd_parser_get_tokens(const char *src_str, tokens_t *toks,
             else
             {
                 /* no next delimiter, so copy all the remaining strings */
-                strcpy((*toks)[cnt], p);
+                strncpy((*toks)[cnt], p, TOKENSIZE - 1);
+                ((*toks)[cnt])[TOKENSIZE - 1] = 0;
                 cnt++;
                 break;
             }
@@ -742,6 +893,10 @@ parse_command(const char *cmd_str, delay_cmd_t *cmd)
     {
         return E_TUXDRV_PARSERISDISABLED;
     }
+    if (strlen(cmd_str) >= CMDSIZE)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
 
     log_debug("parse_command : [%s]", cmd_str);
     memset(&tokens, 0, sizeof(tokens_t));
@@ -1025,6 +1180,19 @@ execute_raw_command (delay_cmd_t *cmd)
     tux_usb_send_raw(cmd->raw_parameters.raw);
 }
 
+/**
+ * \brief Code of a command in the trace.
+ * \param cmd Command.
+ * \return The group, the command and the sub command in one word.
+ */
+static uint32_t
+trace_command_code(const delay_cmd_t *cmd)
+{
+    return ((uint32_t)cmd->command_group << 16) |
+        (((uint32_t)cmd->command & 0xFF) << 8) |
+        ((uint32_t)cmd->sub_command & 0xFF);
+}
+
 /**
  * \brief Execute a command.
  * \param cmd Command to execute.
@@ -1032,6 +1200,8 @@ execute_raw_command (delay_cmd_t *cmd)
 static void
 execute_command (delay_cmd_t *cmd)
 {
+    tux_trace(TUX_TRACE_CMD_EXECUTED, trace_command_code(cmd),
+        &cmd->submission, sizeof(cmd->submission));
     if(cmd->command_group == TUX_CMD)
     {
         switch(cmd->command) {
@@ -1082,6 +1252,7 @@ tux_cmd_parser_clean_sys_command(tux_command_t command)
     int i, j;
     bool have_parent = true;
 
+    stack_lock();
     /* For all sys commands */
     for (i = 0; i < NRCMDS; i++)
     {
@@ -1120,6 +1291,322 @@ tux_cmd_parser_clean_sys_command(tux_command_t command)
             }
         }
     }
+    stack_unlock();
+}
+
+/**
+ * \brief Get the lanes used by a command.
+ * \param cmd Command to check.
+ * \return The lanes mask of the command (0 for raw commands).
+ */
+static unsigned int
+cmd_lanes(const delay_cmd_t *cmd)
+{
+    leds_t leds = LED_NONE;
+    unsigned int lanes = 0;
+
+    if (cmd->command_group != TUX_CMD)
+    {
+        return 0;
+    }
+
+    switch (cmd->command) {
+    case AUDIO:
+    case SOUND_FLASH:
+        return LANE_BIT(CMD_LANE_AUDIO);
+    case EYES:
+        return LANE_BIT(CMD_LANE_EYES);
+    case IR:
+        return LANE_BIT(CMD_LANE_IR);
+    case MOUTH:
+        return LANE_BIT(CMD_LANE_MOUTH);
+    case SPINNING:
+        return LANE_BIT(CMD_LANE_SPINNING);
+    case FLIPPERS:
+        return LANE_BIT(CMD_LANE_FLIPPERS);
+    case LED:
+        switch (cmd->sub_command) {
+        case ON:
+            leds = cmd->led_on_parameters.leds;
+            break;
+        case OFF:
+            leds = cmd->led_off_parameters.leds;
+            break;
+        case PULSE:
+            leds = cmd->led_pulse_parameters.leds;
+            break;
+        case BLINK:
+            leds = cmd->led_blink_parameters.leds;
+            break;
+        case SET:
+            leds = cmd->led_set_parameters.leds;
+            break;
+        default:
+            break;
+        }
+        if (leds & LED_LEFT)
+        {
+            lanes |= LANE_BIT(CMD_LANE_LEFT_LED);
+        }
+        if (leds & LED_RIGHT)
+        {
+            lanes |= LANE_BIT(CMD_LANE_RIGHT_LED);
+        }
+        return lanes;
+    }
+    return 0;
+}
+
+/**
+ * \brief Filter a lanes mask on the policy of the lanes.
+ * \param lanes Lanes mask.
+ * \param policy Minimal policy.
+ * \return The lanes of the mask having at least this policy.
+ */
+static unsigned int
+lanes_with_policy(unsigned int lanes, cmd_lane_policy_t policy)
+{
+    unsigned int ret = 0;
+    int i;
+
+    for (i = 0; i < CMD_LANE_NUMBER; i++)
+    {
+        if ((lanes & LANE_BIT(i)) && (lane_policy[i] >= policy))
+        {
+            ret |= LANE_BIT(i);
+        }
+    }
+    return ret;
+}
+
+/**
+ * \brief Count a command dropped by the lane policy.
+ * \param lanes Lanes which made the command obsolete.
+ */
+static void
+count_dropped(unsigned int lanes)
+{
+    int i;
+
+    for (i = 0; i < CMD_LANE_NUMBER; i++)
+    {
+        if (lanes & LANE_BIT(i))
+        {
+            lane_dropped[i]++;
+        }
+    }
+    tux_stats_count(STATS_COMMANDS_DROPPED);
+}
+
+/**
+ * \brief Drop a command from its stack.
+ * \param cmd Command to drop.
+ * \param lanes Lanes which made the command obsolete.
+ */
+static void
+drop_command(delay_cmd_t *cmd, unsigned int lanes)
+{
+    count_dropped(lanes);
+    cmd->command_group = NO_CMD;
+    cmd->timeout = 0.;
+    cmd->inserted_at_time = 0.;
+}
+
+/**
+ * \brief Drop the pending user commands made obsolete by a new command.
+ * \param cmd New command.
+ *
+ * Only the lanes with the replace or preempt policy are affected, and the
+ * commands of the same submission (e.g. the other lines of a macro) are kept.
+ * The stack mutex must be locked.
+ */
+static void
+replace_pending_commands(const delay_cmd_t *cmd)
+{
+    unsigned int lanes, overlap;
+    int i;
+
+    lanes = lanes_with_policy(cmd_lanes(cmd), LANE_POLICY_REPLACE);
+    if (!lanes)
+    {
+        return;
+    }
+
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if ((user_cmd_stack.cmd_list[i].command_group != NO_CMD) &&
+            (user_cmd_stack.cmd_list[i].submission != cmd->submission))
+        {
+            overlap = cmd_lanes(&user_cmd_stack.cmd_list[i]) & lanes;
+            if (overlap)
+            {
+                drop_command(&user_cmd_stack.cmd_list[i], overlap);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Stop the running commands of the lanes used by a new command.
+ * \param cmd New command.
+ *
+ * A running command is represented by the system command which completes
+ * it (end of an ON_DURING movement). Only the lanes with the preempt policy
+ * are affected. The stack mutex must be locked.
+ */
+static void
+preempt_running_commands(const delay_cmd_t *cmd)
+{
+    unsigned int lanes, overlap;
+    int i;
+
+    lanes = lanes_with_policy(cmd_lanes(cmd), LANE_POLICY_PREEMPT);
+    if (!lanes)
+    {
+        return;
+    }
+
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if (sys_cmd_stack.cmd_list[i].command_group != NO_CMD)
+        {
+            overlap = cmd_lanes(&sys_cmd_stack.cmd_list[i]) & lanes;
+            if (overlap)
+            {
+                drop_command(&sys_cmd_stack.cmd_list[i], overlap);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Check if a due user command is superseded by another due one.
+ * \param idx Index of the command in the user stack.
+ * \param curtime Current time.
+ * \return The lanes on which a later command is also due (0 if none).
+ *
+ * On the lanes which don't queue, only the latest of the commands due in
+ * the same cycle is executed. The stack mutex must be locked.
+ */
+static unsigned int
+superseding_lanes(int idx, double curtime)
+{
+    delay_cmd_t *cmd = &user_cmd_stack.cmd_list[idx];
+    delay_cmd_t *other;
+    unsigned int lanes, overlap;
+    int i;
+
+    lanes = lanes_with_policy(cmd_lanes(cmd), LANE_POLICY_REPLACE);
+    if (!lanes)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < NRCMDS; i++)
+    {
+        other = &user_cmd_stack.cmd_list[i];
+        if ((i == idx) || (other->command_group == NO_CMD) ||
+            (curtime < other->timeout))
+        {
+            continue;
+        }
+        overlap = cmd_lanes(other) & lanes;
+        if (!overlap)
+        {
+            continue;
+        }
+        if ((other->timeout > cmd->timeout) ||
+            ((other->timeout == cmd->timeout) &&
+             ((other->submission > cmd->submission) ||
+              ((other->submission == cmd->submission) && (i > idx)))))
+        {
+            return overlap;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Get a new submission identifier.
+ * \return The identifier.
+ */
+static unsigned int
+new_submission(void)
+{
+    unsigned int ret;
+
+    stack_lock();
+    last_submission++;
+    /* 0 is kept for the system commands */
+    if (last_submission == 0)
+    {
+        last_submission++;
+    }
+    ret = last_submission;
+    stack_unlock();
+    return ret;
+}
+
+/**
+ * \brief Set the policy of a command lane.
+ * \param lane Lane identifier.
+ * \param policy New policy.
+ * \return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_cmd_parser_set_lane_policy(int lane, int policy)
+{
+    if ((lane < 0) || (lane >= CMD_LANE_NUMBER) ||
+        (policy < LANE_POLICY_QUEUE) || (policy > LANE_POLICY_PREEMPT))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    stack_lock();
+    lane_policy[lane] = policy;
+    stack_unlock();
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * \brief Get the number of pending commands of a lane.
+ * \param lane Lane identifier.
+ * \param count Output number of commands (user and system).
+ * \param dropped Output number of commands dropped by the lane policy
+ * since the start, can be NULL.
+ * \return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_cmd_parser_get_lane_occupancy(int lane, int *count, unsigned int *dropped)
+{
+    int i;
+
+    if ((lane < 0) || (lane >= CMD_LANE_NUMBER))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    *count = 0;
+    stack_lock();
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if ((user_cmd_stack.cmd_list[i].command_group != NO_CMD) &&
+            (cmd_lanes(&user_cmd_stack.cmd_list[i]) & LANE_BIT(lane)))
+        {
+            (*count)++;
+        }
+        if ((sys_cmd_stack.cmd_list[i].command_group != NO_CMD) &&
+            (cmd_lanes(&sys_cmd_stack.cmd_list[i]) & LANE_BIT(lane)))
+        {
+            (*count)++;
+        }
+    }
+    if (dropped != NULL)
+    {
+        *dropped = lane_dropped[lane];
+    }
+    stack_unlock();
+    return E_TUXDRV_NOERROR;
 }
 
 /**
@@ -1143,9 +1630,22 @@ insert_command(float delay, delay_cmd_t *cmd, cmd_stack_t *stack)
             stack->cmd_list[i].timeout = delay + curtime;
             stack->cmd_list[i].inserted_at_time = (float)(int)(curtime * 100) / 100.0;
             ret = E_TUXDRV_NOERROR;
+            if (tux_trace_enabled)
+            {
+                uint32_t data[2];
+
+                memcpy(&data[0], &delay, sizeof(float));
+                data[1] = cmd->submission;
+                tux_trace_add(TUX_TRACE_CMD_SCHEDULED, trace_command_code(cmd),
+                    data, sizeof(data));
+            }
             break;
         }
     }
+    if (ret != E_TUXDRV_NOERROR)
+    {
+        tux_stats_count(STATS_COMMANDS_DROPPED);
+    }
     return(ret);
 }
 
@@ -1159,44 +1659,408 @@ tux_cmd_parser_insert_sys_command(float delay, delay_cmd_t *cmd)
 {
     TuxDrvError ret;
 
-#ifdef USE_MUTEX
-    mutex_lock(__stack_mutex);
-#endif
+    stack_lock();
 
     ret = insert_command(delay, cmd, &sys_cmd_stack);
 
-#ifdef USE_MUTEX
-    mutex_unlock(__stack_mutex);
-#endif
+    stack_unlock();
     return ret;
 }
 
 /**
  * \brief Insert a command in the user stack.
  * \param delay Delay before the execution of the command.
- * \param cmd Command to execute.
+ * \param cmd_str Command to execute.
+ * \param submission Submission which the command belongs to.
  */
-LIBLOCAL TuxDrvError
-tux_cmd_parser_insert_user_command(float delay, const char *cmd_str)
+static TuxDrvError
+insert_user_command(float delay, const char *cmd_str, unsigned int submission)
 {
     TuxDrvError ret;
     delay_cmd_t cmd;
 
-#ifdef USE_MUTEX
-    mutex_lock(__stack_mutex);
-#endif
+    stack_lock();
     ret = parse_command(cmd_str, &cmd);
     if (ret == E_TUXDRV_NOERROR)
     {
+        cmd.submission = submission;
+        replace_pending_commands(&cmd);
         ret = insert_command(delay, &cmd, &user_cmd_stack);
     }
 
-#ifdef USE_MUTEX
-    mutex_unlock(__stack_mutex);
-#endif
+    stack_unlock();
+    return ret;
+}
+
+/**
+ * \brief Insert a command in the user stack.
+ * \param delay Delay before the execution of the command.
+ * \param cmd_str Command to execute.
+ */
+LIBLOCAL TuxDrvError
+tux_cmd_parser_insert_user_command(float delay, const char *cmd_str)
+{
+    return insert_user_command(delay, cmd_str, new_submission());
+}
+
+/**
+ * \brief Open a REPEAT or LOOP block in a macro.
+ * \param ctx Macro context.
+ * \param offset Delay before the first iteration.
+ * \param args Block arguments ("<count>,<period>" or "<period>").
+ * \param endless Flag which indicates if the block loops until cancelled.
+ * \return The error result.
+ */
+static TuxDrvError
+open_loop_block(macro_ctx_t *ctx, float offset, const char *args,
+        bool endless)
+{
+    TuxDrvError ret = E_TUXDRV_STACKOVERFLOW;
+    int count = -1;
+    float period = 0.0;
+    int i;
+
+    /* Blocks can't be nested */
+    if (ctx->loop != NULL)
+    {
+        return E_TUXDRV_INVALIDCOMMAND;
+    }
+    if (endless)
+    {
+        if (sscanf(args, "%f", &period) != 1)
+        {
+            return E_TUXDRV_INVALIDCOMMAND;
+        }
+    }
+    else
+    {
+        if ((sscanf(args, "%d,%f", &count, &period) != 2) || (count <= 0))
+        {
+            return E_TUXDRV_INVALIDCOMMAND;
+        }
+    }
+    if (period <= 0.0)
+    {
+        return E_TUXDRV_INVALIDCOMMAND;
+    }
+
+    stack_lock();
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        if (loops[i].state == LOOP_FREE)
+        {
+            loops[i].state = LOOP_COMPILING;
+            loops[i].cmd_count = 0;
+            loops[i].cursor = 0;
+            loops[i].period = period;
+            loops[i].remaining = count;
+            ctx->loop = &loops[i];
+            ctx->loop_offset = offset;
+            ret = E_TUXDRV_NOERROR;
+            break;
+        }
+    }
+    stack_unlock();
     return ret;
 }
 
+/**
+ * \brief Add a command to the block being compiled.
+ * \param ctx Macro context.
+ * \param delay Offset of the command in the block.
+ * \param cmd_str Command string.
+ * \return The error result.
+ */
+static TuxDrvError
+insert_loop_command(macro_ctx_t *ctx, float delay, const char *cmd_str)
+{
+    cmd_loop_t *loop = ctx->loop;
+    TuxDrvError ret;
+    delay_cmd_t cmd;
+    int i;
+
+    ret = parse_command(cmd_str, &cmd);
+    if (ret != E_TUXDRV_NOERROR)
+    {
+        return ret;
+    }
+    if (loop->cmd_count >= NRLOOPCMDS)
+    {
+        return E_TUXDRV_STACKOVERFLOW;
+    }
+
+    cmd.submission = ctx->submission;
+    cmd.timeout = delay;
+    cmd.inserted_at_time = 0.;
+
+    /* Keep the timeline sorted, in the macro order for equal offsets */
+    i = loop->cmd_count;
+    while ((i > 0) && (loop->cmd_list[i - 1].timeout > delay))
+    {
+        loop->cmd_list[i] = loop->cmd_list[i - 1];
+        i--;
+    }
+    loop->cmd_list[i] = cmd;
+    loop->cmd_count++;
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * \brief Close the block being compiled.
+ * \param ctx Macro context.
+ * \param arm Schedule the block if true, discard it otherwise.
+ * \return The error result, E_TUXDRV_INVALIDPARAMETER if an iteration
+ * would start before the end of the previous one.
+ */
+static TuxDrvError
+close_loop_block(macro_ctx_t *ctx, bool arm)
+{
+    cmd_loop_t *loop = ctx->loop;
+    TuxDrvError ret = E_TUXDRV_NOERROR;
+    int i;
+
+    if (loop == NULL)
+    {
+        return E_TUXDRV_INVALIDCOMMAND;
+    }
+
+    /* The timeline is sorted, its last command has the largest offset */
+    if (arm && (loop->cmd_count > 0) &&
+        (loop->period < loop->cmd_list[loop->cmd_count - 1].timeout))
+    {
+        ret = E_TUXDRV_INVALIDPARAMETER;
+        arm = false;
+    }
+
+    stack_lock();
+    if (arm && (loop->cmd_count > 0))
+    {
+        /* The block replaces the pending commands like any command of
+         * the macro */
+        for (i = 0; i < loop->cmd_count; i++)
+        {
+            replace_pending_commands(&loop->cmd_list[i]);
+        }
+        loop->start_time = get_time() + ctx->loop_offset;
+        loop->cursor = 0;
+        loop->state = LOOP_ARMED;
+    }
+    else
+    {
+        loop->state = LOOP_FREE;
+    }
+    stack_unlock();
+    ctx->loop = NULL;
+
+    return ret;
+}
+
+/**
+ * \brief Get the lanes of the movements which are running.
+ * \param curtime Current time.
+ * \return The lanes mask.
+ *
+ * A running movement is represented by its pending completion system
+ * command. The stack mutex must be locked.
+ */
+static unsigned int
+running_lanes(double curtime)
+{
+    unsigned int lanes = 0;
+    int i;
+
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if ((sys_cmd_stack.cmd_list[i].command_group != NO_CMD) &&
+            (curtime < sys_cmd_stack.cmd_list[i].timeout))
+        {
+            lanes |= cmd_lanes(&sys_cmd_stack.cmd_list[i]);
+        }
+    }
+    return lanes;
+}
+
+/**
+ * \brief Count a conflict if a command starts on a busy lane.
+ * \param cmd Command which starts.
+ * \param running Lanes of the running movements.
+ * \param cycle_lanes Lanes already used in this cycle, updated.
+ *
+ * The stack mutex must be locked.
+ */
+static void
+check_conflict(const delay_cmd_t *cmd, unsigned int running,
+        unsigned int *cycle_lanes)
+{
+    unsigned int lanes = cmd_lanes(cmd);
+
+    if (lanes & (running | *cycle_lanes))
+    {
+        lane_conflicts++;
+    }
+    *cycle_lanes |= lanes;
+}
+
+/**
+ * \brief Apply the replace policy between a due loop command and the due
+ * user commands.
+ * \param cmd Loop command.
+ * \param due_time Time at which the loop command is due.
+ * \param curtime Current time.
+ * \return The lanes on which a later user command is also due (0 if none),
+ * the earlier user commands are dropped.
+ *
+ * The stack mutex must be locked.
+ */
+static unsigned int
+supersede_loop_command(const delay_cmd_t *cmd, double due_time,
+        double curtime)
+{
+    delay_cmd_t *other;
+    unsigned int lanes, overlap, superseded = 0;
+    int i;
+
+    lanes = lanes_with_policy(cmd_lanes(cmd), LANE_POLICY_REPLACE);
+    if (!lanes)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < NRCMDS; i++)
+    {
+        other = &user_cmd_stack.cmd_list[i];
+        if ((other->command_group == NO_CMD) || (curtime < other->timeout))
+        {
+            continue;
+        }
+        overlap = cmd_lanes(other) & lanes;
+        if (!overlap)
+        {
+            continue;
+        }
+        if (other->timeout > due_time)
+        {
+            superseded |= overlap;
+        }
+        else
+        {
+            drop_command(other, overlap);
+        }
+    }
+    return superseded;
+}
+
+/**
+ * \brief Collect the expired commands of the macro loops.
+ * \param curtime Current time.
+ * \param running Lanes of the running movements.
+ * \param cycle_lanes Lanes already used in this cycle, updated.
+ *
+ * The timeline of a block is never copied in the stacks : a cursor walks
+ * it and is rewound when the iteration is complete. At most one iteration
+ * of a block is started per call. On the lanes which don't queue, a loop
+ * command and a user command due in the same cycle follow the replace
+ * policy : only the latest one is executed. Called before the collection
+ * of the user commands. The stack mutex must be locked.
+ */
+static void
+collect_loops(double curtime, unsigned int running,
+        unsigned int *cycle_lanes)
+{
+    cmd_loop_t *loop;
+    delay_cmd_t *cmd;
+    unsigned int lanes;
+    double due_time;
+    int i;
+
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        loop = &loops[i];
+        if (loop->state != LOOP_ARMED)
+        {
+            continue;
+        }
+
+        while ((loop->cursor < loop->cmd_count) &&
+               (curtime >= (loop->start_time +
+                            loop->cmd_list[loop->cursor].timeout)))
+        {
+            due_time = loop->start_time + loop->cmd_list[loop->cursor].timeout;
+            lanes = supersede_loop_command(&loop->cmd_list[loop->cursor],
+                due_time, curtime);
+            if (lanes)
+            {
+                count_dropped(lanes);
+                loop->cursor++;
+                continue;
+            }
+            cmd = collect_command(&loop->cmd_list[loop->cursor]);
+            cmd->inserted_at_time = (float)(int)(curtime * 100) / 100.0;
+            check_conflict(cmd, running, cycle_lanes);
+            preempt_running_commands(cmd);
+            loop->cursor++;
+        }
+
+        if (loop->cursor >= loop->cmd_count)
+        {
+            if (loop->remaining > 0)
+            {
+                loop->remaining--;
+            }
+            if (loop->remaining == 0)
+            {
+                loop->state = LOOP_FREE;
+            }
+            else
+            {
+                loop->start_time += loop->period;
+                loop->cursor = 0;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Cancel the scheduled macro loops.
+ * \return The number of cancelled loops.
+ */
+LIBLOCAL int
+tux_cmd_parser_cancel_loops(void)
+{
+    int i, count = 0;
+
+    stack_lock();
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        if (loops[i].state == LOOP_ARMED)
+        {
+            loops[i].state = LOOP_FREE;
+            count++;
+        }
+    }
+    stack_unlock();
+    return count;
+}
+
+/**
+ * \brief Execute the collected commands.
+ *
+ * The stack mutex must not be locked : the commands can insert system
+ * commands or clean the system stack.
+ */
+static void
+execute_due_commands(void)
+{
+    int i;
+
+    for (i = 0; i < due_cmds.cmd_count; i++)
+    {
+        execute_command(&due_cmds.cmd_list[i]);
+    }
+    due_cmds.cmd_count = 0;
+}
+
 /**
  * \brief Clear the delayed commands from the system stack.
  * \return The result success.
@@ -1207,30 +2071,39 @@ tux_cmd_parser_clear_delay_commands(void)
     int i;
 
 #ifdef USE_MUTEX
-    mutex_lock(__stack_mutex);
+    mutex_lock(__exec_mutex);
 #endif
+    stack_lock();
 
     /* Clear user cmd */
     memset(&user_cmd_stack, 0, sizeof(cmd_stack_t));
 
-    /* process all pending system commands */
+    /* Cancel the macro loops (the blocks being parsed are kept) */
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        if (loops[i].state == LOOP_ARMED)
+        {
+            loops[i].state = LOOP_FREE;
+        }
+    }
+
+    /* Collect all pending system commands */
     for (i = 0; i < NRCMDS; i++)
     {
         if (sys_cmd_stack.cmd_list[i].command_group != NO_CMD)
         {
-            execute_command(&sys_cmd_stack.cmd_list[i]);
-            /* no need to execute the following command as we are going
-               to clear the complete stack after this for loop
-               memset(&sys_cmd_stack.cmd_list[i], 0, sizeof(delay_cmd_t));
-            */
+            collect_command(&sys_cmd_stack.cmd_list[i]);
         }
     }
 
     /* Clear system cmd */
     memset(&sys_cmd_stack, 0, sizeof(cmd_stack_t));
 
+    stack_unlock();
+
+    execute_due_commands();
 #ifdef USE_MUTEX
-    mutex_unlock(__stack_mutex);
+    mutex_unlock(__exec_mutex);
 #endif
 
     return true;
@@ -1243,19 +2116,45 @@ LIBLOCAL void
 tux_cmd_parser_delay_stack_perform(void)
 {
     int i;
+    unsigned int lanes, running, cycle_lanes = 0;
     double curtime = get_time();
 
 #ifdef USE_MUTEX
-    mutex_lock(__stack_mutex);
+    mutex_lock(__exec_mutex);
 #endif
+    stack_lock();
 
+    running = running_lanes(curtime);
+
+    /* Drop the due commands superseded by a later one of the same lane */
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if ((user_cmd_stack.cmd_list[i].command_group != NO_CMD) &&
+            (curtime >= user_cmd_stack.cmd_list[i].timeout))
+        {
+            lanes = superseding_lanes(i, curtime);
+            if (lanes)
+            {
+                drop_command(&user_cmd_stack.cmd_list[i], lanes);
+            }
+        }
+    }
+
+    collect_loops(curtime, running, &cycle_lanes);
+
+    /* Only collect the due commands here, they are executed once the
+     * stack is unlocked.
+     */
     for (i = 0; i < NRCMDS; i++)
     {
         if (user_cmd_stack.cmd_list[i].command_group != NO_CMD)
         {
             if (curtime >= user_cmd_stack.cmd_list[i].timeout)
             {
-                execute_command(&user_cmd_stack.cmd_list[i]);
+                check_conflict(&user_cmd_stack.cmd_list[i], running,
+                    &cycle_lanes);
+                preempt_running_commands(&user_cmd_stack.cmd_list[i]);
+                collect_command(&user_cmd_stack.cmd_list[i]);
                 /* next two commands are faster than a memset
                    writing a null byte to the first char of cmd is sufficient
                    to make it an empty string
@@ -1268,35 +2167,137 @@ tux_cmd_parser_delay_stack_perform(void)
         {
             if (curtime >= sys_cmd_stack.cmd_list[i].timeout)
             {
-                execute_command(&sys_cmd_stack.cmd_list[i]);
+                collect_command(&sys_cmd_stack.cmd_list[i]);
                 sys_cmd_stack.cmd_list[i].timeout = 0;
                 sys_cmd_stack.cmd_list[i].command_group = NO_CMD;
             }
         }
     }
 
+    stack_unlock();
+
+    execute_due_commands();
+#ifdef USE_MUTEX
+    mutex_unlock(__exec_mutex);
+#endif
+}
+
+/**
+ * \brief Get the number of scheduled commands and macro loops.
+ * \return The number of pending entries.
+ */
+LIBLOCAL int
+tux_cmd_parser_get_pending(void)
+{
+    int i, count = 0;
+
+    stack_lock();
+    for (i = 0; i < NRCMDS; i++)
+    {
+        if (user_cmd_stack.cmd_list[i].command_group != NO_CMD)
+        {
+            count++;
+        }
+        if (sys_cmd_stack.cmd_list[i].command_group != NO_CMD)
+        {
+            count++;
+        }
+    }
+    for (i = 0; i < NRLOOPS; i++)
+    {
+        if (loops[i].state == LOOP_ARMED)
+        {
+            count++;
+        }
+    }
+    stack_unlock();
+    return count;
+}
+
+/**
+ * \brief Get the number of commands started on a busy lane.
+ * \return The conflicts count.
+ *
+ * A lane is busy when a movement is running on it or when another command
+ * has already been started on it in the same cycle.
+ */
+LIBLOCAL unsigned int
+tux_cmd_parser_get_conflicts(void)
+{
+    unsigned int ret;
+
+    stack_lock();
+    ret = lane_conflicts;
+    stack_unlock();
+    return ret;
+}
+
+/**
+ * \brief Get the hold time histogram of the stack lock.
+ * \param histogram Output buckets, bucket n counts the hold times from
+ * 2^n to 2^(n+1) microseconds (bucket 0 also counts the shorter ones,
+ * the last bucket the longer ones).
+ * \param size Number of buckets of the output array.
+ * \return The number of buckets written.
+ */
+LIBLOCAL int
+tux_cmd_parser_get_lock_histogram(unsigned int *histogram, int size)
+{
+    int count = (size < LOCK_HISTOGRAM_SIZE) ? size : LOCK_HISTOGRAM_SIZE;
+
+#ifdef USE_MUTEX
+    mutex_lock(__stack_mutex);
+#endif
+    memcpy(histogram, lock_histogram, count * sizeof(unsigned int));
 #ifdef USE_MUTEX
     mutex_unlock(__stack_mutex);
 #endif
+    return count;
 }
 
 /**
  * \brief Parse a command line string.
  * \param line_str Line to parse.
- * \return The error result (always E_TUXDRV_NOERROR).
+ * \param ctx Macro context.
+ * \return The error result.
+ *
+ * Besides the "<delay>:<command>" lines, a macro can contain blocks :
+ * "<offset>:REPEAT:<count>,<period>" or "<offset>:LOOP:<period>", followed
+ * by commands whose delays are relative to the start of the block, and
+ * closed by "END". A LOOP block runs until the loops are cancelled.
  */
 static TuxDrvError
-parse_line(const char *line_str)
+parse_line(const char *line_str, macro_ctx_t *ctx)
 {
     float delay= 0.0;
     char cmd_str[CMDSIZE] = "";
+    char keyword[8] = "";
     int i;
 
-    i = sscanf(line_str, "%f:%[^\n]", &delay, cmd_str);
+    if ((sscanf(line_str, " %7[A-Z]", keyword) == 1) &&
+        (strcmp(keyword, "END") == 0))
+    {
+        return close_loop_block(ctx, true);
+    }
+
+    /* The width is CMDSIZE - 1 */
+    i = sscanf(line_str, "%f:%1023[^\n]", &delay, cmd_str);
 
     if (i == 2)
     {
-        return tux_cmd_parser_insert_user_command(delay, cmd_str);
+        if (strncmp(cmd_str, "REPEAT:", 7) == 0)
+        {
+            return open_loop_block(ctx, delay, cmd_str + 7, false);
+        }
+        if (strncmp(cmd_str, "LOOP:", 5) == 0)
+        {
+            return open_loop_block(ctx, delay, cmd_str + 5, true);
+        }
+        if (ctx->loop != NULL)
+        {
+            return insert_loop_command(ctx, delay, cmd_str);
+        }
+        return insert_user_command(delay, cmd_str, ctx->submission);
     }
 
     return E_TUXDRV_NOERROR;
@@ -1315,6 +2316,12 @@ tux_cmd_parser_parse_macro(const char *macro_str)
     char *line_tmp;
     char macro[MACROSIZE];
     TuxDrvError ret = E_TUXDRV_NOERROR;
+    macro_ctx_t ctx = { new_submission(), NULL, 0.0 };
+
+    if (strlen(macro_str) >= MACROSIZE)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
 
 #ifdef USE_MUTEX
     mutex_lock(__macro_mutex);
@@ -1327,11 +2334,12 @@ tux_cmd_parser_parse_macro(const char *macro_str)
     strcpy(macro, macro_str);
     if ((line_tmp = strtok(macro, lex_ret)) != NULL)
     {
-        ret = parse_line(line_tmp);
+        ret = parse_line(line_tmp, &ctx);
         if (ret != E_TUXDRV_NOERROR)
         {
             if (ret != E_TUXDRV_INVALIDCOMMAND)
             {
+                close_loop_block(&ctx, false);
 #ifdef USE_MUTEX
                 mutex_unlock(__macro_mutex);
 #endif
@@ -1341,11 +2349,12 @@ tux_cmd_parser_parse_macro(const char *macro_str)
 
         while ((line_tmp = strtok(NULL, lex_ret)) != NULL)
         {
-            ret = parse_line(line_tmp);
+            ret = parse_line(line_tmp, &ctx);
             if (ret != E_TUXDRV_NOERROR)
             {
                 if (ret != E_TUXDRV_INVALIDCOMMAND)
                 {
+                    close_loop_block(&ctx, false);
 #ifdef USE_MUTEX
                     mutex_unlock(__macro_mutex);
 #endif
@@ -1354,6 +2363,12 @@ tux_cmd_parser_parse_macro(const char *macro_str)
             }
         }
     }
+    /* A block left open is closed by the end of the macro */
+    if ((ctx.loop != NULL) &&
+        (close_loop_block(&ctx, true) != E_TUXDRV_NOERROR))
+    {
+        ret = E_TUXDRV_INVALIDPARAMETER;
+    }
 
 #ifdef USE_MUTEX
     mutex_unlock(__macro_mutex);
@@ -1373,6 +2388,7 @@ tux_cmd_parser_parse_file(const char *file_path)
     char line[CMDSIZE] = "";
     FILE *macro_file;
     TuxDrvError ret = E_TUXDRV_NOERROR;
+    macro_ctx_t ctx = { new_submission(), NULL, 0.0 };
 
 #ifdef USE_MUTEX
     mutex_lock(__macro_mutex);
@@ -1383,11 +2399,13 @@ tux_cmd_parser_parse_file(const char *file_path)
     {
         while (fgets(line, sizeof(line)-2, macro_file) != NULL)
         {
-            ret = parse_line(line);
+            ret = parse_line(line, &ctx);
             if (ret != E_TUXDRV_NOERROR)
             {
                 if (ret != E_TUXDRV_INVALIDCOMMAND)
                 {
+                    close_loop_block(&ctx, false);
+                    fclose(macro_file);
 #ifdef USE_MUTEX
                     mutex_unlock(__macro_mutex);
 #endif
@@ -1396,6 +2414,12 @@ tux_cmd_parser_parse_file(const char *file_path)
             }
         }
         fclose(macro_file);
+        /* A block left open is closed by the end of the file */
+        if ((ctx.loop != NULL) &&
+            (close_loop_block(&ctx, true) != E_TUXDRV_NOERROR))
+        {
+            ret = E_TUXDRV_INVALIDPARAMETER;
+        }
     }
     else
     {
@@ -1428,7 +2452,20 @@ tux_cmd_parser_parse_command(const char *cmd_str)
     ret = parse_command(cmd_str, &cmd);
     if (ret == E_TUXDRV_NOERROR)
     {
+        cmd.submission = new_submission();
+        /* A completion command already collected by the read loop must not
+         * run after the command which preempts it */
+#ifdef USE_MUTEX
+        mutex_lock(__exec_mutex);
+#endif
+        stack_lock();
+        replace_pending_commands(&cmd);
+        preempt_running_commands(&cmd);
+        stack_unlock();
         execute_command(&cmd);
+#ifdef USE_MUTEX
+        mutex_unlock(__exec_mutex);
+#endif
     }
     return ret;
 }
@@ -43,6 +43,26 @@ typedef char token_str_t[TOKENSIZE];
 /** \brief Token string array */
 typedef token_str_t tokens_t[MAXNRTOKENS];
 
+/** \brief Command lanes, one per actuator */
+typedef enum {
+    CMD_LANE_EYES = 0, /**< Eyes motor */
+    CMD_LANE_MOUTH, /**< Mouth motor */
+    CMD_LANE_FLIPPERS, /**< Flippers motor */
+    CMD_LANE_SPINNING, /**< Spinning motors */
+    CMD_LANE_LEFT_LED, /**< Left led */
+    CMD_LANE_RIGHT_LED, /**< Right led */
+    CMD_LANE_AUDIO, /**< Audio channel and sound flash */
+    CMD_LANE_IR, /**< Infrared */
+    CMD_LANE_NUMBER
+} cmd_lane_t;
+
+/** \brief Behaviour of a lane when a new command targets it */
+typedef enum {
+    LANE_POLICY_QUEUE = 0, /**< Commands run in sequence (default) */
+    LANE_POLICY_REPLACE, /**< A new command drops the pending ones */
+    LANE_POLICY_PREEMPT, /**< Like replace, and also stops the running one */
+} cmd_lane_policy_t;
+
 extern void tux_cmd_parser_init(void);
 extern void tux_cmd_parser_set_enable(bool value);
 extern int tux_cmd_parser_get_tokens(const char *src_str, tokens_t *toks,
@@ -57,5 +77,13 @@ extern void tux_cmd_parser_clean_sys_command(tux_command_t command);
 extern void tux_cmd_parser_delay_stack_perform(void);
 extern TuxDrvError tux_cmd_parser_parse_macro(const char *macro_str);
 extern TuxDrvError tux_cmd_parser_parse_file(const char *file_path);
+extern int tux_cmd_parser_cancel_loops(void);
+extern int tux_cmd_parser_get_pending(void);
+extern unsigned int tux_cmd_parser_get_conflicts(void);
+extern int tux_cmd_parser_get_lock_histogram(unsigned int *histogram,
+    int size);
+extern TuxDrvError tux_cmd_parser_set_lane_policy(int lane, int policy);
+extern TuxDrvError tux_cmd_parser_get_lane_occupancy(int lane, int *count,
+    unsigned int *dropped);
 
 #endif /* _TUX_CMD_PARSER_H_ */
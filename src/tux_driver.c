@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include "log.h"
+#include "tux_analyzer.h"
 #include "tux_battery.h"
 #include "tux_cmd_parser.h"
 #include "tux_descriptor.h"
@@ -34,8 +35,11 @@
 #include "tux_light.h"
 #include "tux_mouth.h"
 #include "tux_pong.h"
+#include "tux_shm_publisher.h"
 #include "tux_sound_flash.h"
+#include "tux_stats.h"
 #include "tux_sw_status.h"
+#include "tux_tracer.h"
 #include "tux_user_inputs.h"
 #include "tux_spinning.h"
 #include "tux_usb.h"
@@ -44,6 +48,7 @@
 #include "version.h"
 
 static bool driver_started = false;
+static bool offline_modules_ready = false;
 static simple_callback_t end_cycle_funct;
 static simple_callback_t dongle_connected_funct;
 static simple_callback_t dongle_disconnected_funct;
@@ -114,6 +119,254 @@ TuxDrv_SetStatusCallback(event_callback_t funct)
     tux_sw_status_set_event_callback(funct);
 }
 
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_SetStatusCallbackEx(event_ex_callback_t funct)
+{
+    tux_sw_status_set_event_ex_callback(funct);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_SetStatusSubscription(uint64_t mask)
+{
+    tux_sw_status_set_subscription(mask);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_SetStatusCallbackMask(uint64_t mask)
+{
+    tux_sw_status_set_event_mask(mask);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_SetStatusCallbackExMask(uint64_t mask)
+{
+    tux_sw_status_set_event_ex_mask(mask);
+}
+
+/**
+ * Set the callback which receives all the status events of a read cycle in
+ * one call, at the end of the cycle.
+ */
+LIBEXPORT void
+TuxDrv_SetStatusBatchCallback(event_batch_callback_t funct)
+{
+    tux_sw_status_set_event_batch_callback(funct);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_SetStatusBatchMask(uint64_t mask)
+{
+    tux_sw_status_set_event_batch_mask(mask);
+}
+
+/**
+ * Select the thread which calls the status callbacks and the behaviour of
+ * the event queue when the callbacks are slower than the updates.
+ * Must not be called from a status callback.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetStatusDispatchMode(int mode, int policy)
+{
+    return tux_sw_status_set_dispatch_mode(mode, policy);
+}
+
+/**
+ * Call the status callbacks of the queued events, in the poll mode.
+ */
+LIBEXPORT int
+TuxDrv_DispatchStatusEvents(int max_events)
+{
+    return tux_sw_status_dispatch_events(max_events);
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetPingRate(float pings_per_second, int burst_size)
+{
+    return tux_pong_set_rate(pings_per_second, burst_size);
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetLinkQuality(link_quality_t *quality)
+{
+    if (quality == NULL)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    tux_pong_get_quality(quality);
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_StartTrace(const char *path)
+{
+    return tux_trace_start(path);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_StopTrace(void)
+{
+    tux_trace_stop();
+}
+
+/**
+ *
+ */
+LIBEXPORT int
+TuxDrv_ReadTrace(tux_trace_record_t *records, int max)
+{
+    if ((records == NULL) || (max <= 0))
+    {
+        return 0;
+    }
+
+    return tux_trace_read(records, max);
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStats(tux_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    tux_stats_get(stats);
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStatusDispatchStats(status_dispatch_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    tux_sw_status_get_dispatch_stats(stats);
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * Set the event filter of a status : minimal change from the last event
+ * (in the unit of the status), additional change needed to go back, and
+ * minimal time between two events (seconds).
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetStatusEventFilter(int id, float threshold, float hysteresis,
+        float min_interval)
+{
+    return tux_sw_status_set_event_filter(id, threshold, hysteresis,
+            min_interval);
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStatusEventFilter(int id, float *threshold, float *hysteresis,
+        float *min_interval)
+{
+    if ((threshold == NULL) || (hysteresis == NULL) || (min_interval == NULL))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    return tux_sw_status_get_event_filter(id, threshold, hysteresis,
+            min_interval);
+}
+
+/**
+ * Select the statuses which keep the history of their values.
+ */
+LIBEXPORT void
+TuxDrv_SetStatusHistory(uint64_t mask)
+{
+    tux_sw_status_set_history(mask);
+}
+
+/**
+ * Read the values of a status changed after a monotonic time, oldest first.
+ * Return the number of samples written in out.
+ */
+LIBEXPORT int
+TuxDrv_GetStatusHistory(int id, double since, status_sample_t *out, int max)
+{
+    return tux_sw_status_get_history(id, since, out, max);
+}
+
+/**
+ * Publish the statuses in a POSIX shared memory segment at the end of each
+ * read cycle. name is the name of the segment, NULL for the default one.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_StartStatusPublisher(const char *name)
+{
+    return tux_shm_publisher_start(name);
+}
+
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_StopStatusPublisher(void)
+{
+    tux_shm_publisher_stop();
+}
+
+/**
+ * Get a consistent copy of all the statuses.
+ * The copy never blocks the read loop which updates the statuses.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStatusSnapshot(status_snapshot_t *snapshot)
+{
+    if (snapshot == NULL)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    tux_sw_status_get_snapshot(snapshot);
+
+    return E_TUXDRV_NOERROR;
+}
+
 /**
  *
  */
@@ -141,6 +394,25 @@ TuxDrv_SetDongleDisconnectedCallback(simple_callback_t funct)
     dongle_disconnected_funct = funct;
 }
 
+/**
+ *  Initialize the modules needed without the dongle, when the driver is
+ *  not started.
+ */
+static void
+init_offline_modules(void)
+{
+    if (!driver_started && !offline_modules_ready)
+    {
+        tux_stats_init();
+        tux_pong_init();
+        tux_usb_init_module();
+        tux_hw_status_init();
+        tux_sw_status_init();
+        tux_cmd_parser_init();
+        offline_modules_ready = true;
+    }
+}
+
 /**
  *  Callback function on frame receiving.
  *  @param data 4 bytes array of status.
@@ -148,116 +420,20 @@ TuxDrv_SetDongleDisconnectedCallback(simple_callback_t funct)
 static void
 on_frame(const unsigned char *data)
 {
-    unsigned char header;
     int ret;
 
-    header = data[0];
+    /* The frame descriptors call the updaters of the changed fields */
     ret = tux_hw_status_parse_frame(data);
 
     if (ret == -1)
     {
+        tux_stats_count(STATS_UNKNOWN_FRAMES);
         log_warning("STATUS FRAME : %.2x %.2x %.2x %.2x",
             data[0],
             data[1],
             data[2],
             data[3]);
     }
-
-    switch (header)
-    {
-    /* Descriptor frames */
-    case FRAME_HEADER_VERSION:
-        tux_firmware_update_version();
-        break;
-    case FRAME_HEADER_REVISION:
-        tux_firmware_update_revision();
-        break;
-    case FRAME_HEADER_AUTHOR:
-        tux_firmware_update_author();
-        break;
-    case FRAME_HEADER_SOUND_VAR:
-        tux_sound_flash_update();
-        break;
-    /* Status frames */
-    case FRAME_HEADER_PORTS:
-        if (header == ret)
-        {
-            tux_spinning_update_direction();
-            tux_mouth_update_position();
-            tux_eyes_update_position();
-        }
-        break;
-    case FRAME_HEADER_POSITION1:
-        if (header == ret)
-        {
-            tux_flippers_update_movements_remaining();
-            tux_mouth_update_movements_remaining();
-            tux_eyes_update_movements_remaining();
-        }
-        break;
-    case FRAME_HEADER_POSITION2:
-        if (header == ret)
-        {
-            tux_flippers_update_position();
-            tux_spinning_update_movements_remaining();
-            tux_eyes_update_motor();
-            tux_mouth_update_motor();
-            tux_flippers_update_motor();
-            tux_spinning_update_left_motor();
-            tux_spinning_update_right_motor();
-        }
-        break;
-    case FRAME_HEADER_SENSORS1:
-        if (header == ret)
-        {
-            tux_sound_flash_update_general_play();
-            tux_user_inputs_update_head_button();
-            tux_user_inputs_update_left_wing_button();
-            tux_user_inputs_update_right_wing_button();
-        }
-        break;
-    case FRAME_HEADER_ID:
-        tux_id_update_number();
-        break;
-    case FRAME_HEADER_IR:
-        tux_user_inputs_init_time_RC5();
-        break;
-    case FRAME_HEADER_BATTERY:
-        tux_user_inputs_update_charger_state();
-        if (header == ret)
-        {
-            tux_battery_update_level();
-        }
-        break;
-    case FRAME_HEADER_LIGHT:
-        if (header == ret)
-        {
-            tux_light_update_level();
-        }
-        break;
-    case FRAME_HEADER_LED:
-        if (header == ret)
-        {
-            tux_leds_update_left();
-            tux_leds_update_right();
-        }
-        break;
-    /* Don't work ...
-    case FRAME_HEADER_FLASH_PROG:
-        if (header == ret)
-        {
-            tux_sound_flash_update_prog_current_track();
-            tux_sound_flash_update_prog_last_track_size();
-        }
-        break;
-    */
-    case FRAME_HEADER_AUDIO:
-        tux_sound_flash_update_flash_play();
-        break;
-    /*case FRAME_HEADER_PONG:
-        tux_pong_update();
-        break;*/
-    }
 }
 
 /**
@@ -268,6 +444,8 @@ static void
 on_rf_state(unsigned char state)
 {
     tux_sw_status_set_intvalue(SW_ID_RF_STATE, state, true);
+    /* The quality of the previous link is meaningless */
+    tux_pong_reset();
     if (state)
     {
         tux_descriptor_get();
@@ -326,10 +504,13 @@ static void
 on_read_loop_cycle_complete(void)
 {
     tux_user_inputs_update_RC5();
-    /* tux_pong_get(); */
+    tux_pong_get();
     /* tux_firmware_state_machine_call(); */
     tux_sound_flash_state_machine_call();
+    tux_stats_end_cycle(tux_hw_status_header_counter);
     tux_hw_status_header_counter_check();
+    tux_sw_status_flush_event_batch();
+    tux_shm_publisher_publish();
 
     if (end_cycle_funct)
     {
@@ -357,6 +538,21 @@ TuxDrv_PerformCommand(double delay, const char *cmd_str)
     }
 }
 
+/**
+ * Insert a command in the command stack, even without delay. The command
+ * is executed by the read loop, so the caller never waits for the USB.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_QueueCommand(double delay, const char *cmd_str)
+{
+    if (delay < 0.0)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+    log_debug("Queue a command : [%s], %f", cmd_str, delay);
+    return tux_cmd_parser_insert_user_command(delay, cmd_str);
+}
+
 /**
  *
  */
@@ -384,6 +580,124 @@ TuxDrv_PerformMacroText(const char *macro)
     return tux_cmd_parser_parse_macro(macro);
 }
 
+/**
+ *
+ */
+LIBEXPORT void
+TuxDrv_CancelMacroLoops(void)
+{
+    tux_cmd_parser_cancel_loops();
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStackLockHistogram(unsigned int *histogram, int size)
+{
+    if ((histogram == NULL) || (size <= 0))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+    tux_cmd_parser_get_lock_histogram(histogram, size);
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * Analyze a macro on a virtual clock, without the dongle.
+ * The analysis swaps the time source and clears the command stacks, so it
+ * is refused with E_TUXDRV_BUSY while the driver is started.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_AnalyzeMacro(const char *macro, float max_duration,
+        macro_analysis_t *analysis)
+{
+    if (driver_started)
+    {
+        return E_TUXDRV_BUSY;
+    }
+    /* The analysis can be done without starting the driver */
+    init_offline_modules();
+    return tux_analyzer_run_macro(macro, max_duration, analysis);
+}
+
+/**
+ *  Decode status frames as if they were received from the dongle, to replay
+ *  a recorded traffic or to measure the decoder. Refused while the driver
+ *  runs, the read loop owns the decoder then.
+ *  @param frames Frames, 4 bytes each.
+ *  @param count Number of frames.
+ *  @return E_TUXDRV_BUSY when the driver is started.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_InjectStatusFrames(const unsigned char *frames, int count)
+{
+    int i;
+
+    if ((frames == NULL) || (count < 0))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+    if (driver_started)
+    {
+        return E_TUXDRV_BUSY;
+    }
+    init_offline_modules();
+    for (i = 0; i < count; i++)
+    {
+        on_frame(&frames[i * 4]);
+    }
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ *  Set the time source and the sleep function of the driver.
+ *  @return E_TUXDRV_BUSY when the driver is started.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetTimeSource(time_source_t time_funct, sleep_funct_t sleep_funct)
+{
+    if (driver_started)
+    {
+        return E_TUXDRV_BUSY;
+    }
+    set_time_source(time_funct, sleep_funct);
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ *  Use the built-in virtual clock as time source.
+ *  @return E_TUXDRV_BUSY when the driver is started.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetVirtualClock(double start_time)
+{
+    if (driver_started)
+    {
+        return E_TUXDRV_BUSY;
+    }
+    set_virtual_time_source(start_time);
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_SetLanePolicy(int lane, int policy)
+{
+    return tux_cmd_parser_set_lane_policy(lane, policy);
+}
+
+/**
+ *
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetLaneOccupancy(int lane, int *count, unsigned int *dropped)
+{
+    return tux_cmd_parser_get_lane_occupancy(lane, count, dropped);
+}
+
 /**
  *
  */
@@ -393,6 +707,17 @@ TuxDrv_SoundReflash(const char *tracks)
     return tux_sound_flash_cmd_reflash(tracks);
 }
 
+/**
+ * Get the track refused by the last TuxDrv_SoundReflash.
+ * \return The position of the track in the list, from 1, or 0 when the
+ * tracks were accepted.
+ */
+LIBEXPORT int
+TuxDrv_GetSoundReflashBadTrack(void)
+{
+    return tux_sound_flash_get_bad_track();
+}
+
 /**
  *
  */
@@ -438,6 +763,16 @@ TuxDrv_GetStatusId(const char *name, int *id)
     return tux_sw_status_id_from_name(name, id);
 }
 
+/**
+ * Get the identifier of a status from a state string given to the status
+ * callback, without tokenizing it.
+ */
+LIBEXPORT TuxDrvError
+TuxDrv_GetStatusIdFromState(const char *state, int *id)
+{
+    return tux_sw_status_id_from_state(state, id);
+}
+
 /**
  *
  */
@@ -535,6 +870,8 @@ TuxDrv_Start(void)
         VER_UPDATE,
         VER_REVISION);
 
+    tux_stats_init();
+    tux_pong_init();
     tux_usb_init_module();
     tux_usb_set_frame_callback(on_frame);
     tux_usb_set_rf_state_callback(on_rf_state);
@@ -551,7 +888,7 @@ TuxDrv_Start(void)
     while (driver_started)
     {
         tux_usb_start();
-        sleep(1);
+        wait_seconds(1.0);
     }
 
     tux_usb_exit_module();
@@ -565,4 +902,5 @@ TuxDrv_Stop(void)
 {
     driver_started = false;
     tux_usb_stop();
+    tux_sw_status_stop();
 }
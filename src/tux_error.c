@@ -59,6 +59,14 @@ tux_error_strerror(TuxDrvError error_code)
         return "The system is busy";
     case E_TUXDRV_WAVSIZEEXCEDED:
         return "The size of the selection exceeds 127 blocks";
+    case E_TUXDRV_WAVNOTFOUND:
+        return "The wave file can't be read";
+    case E_TUXDRV_WAVNOTRIFF:
+        return "The file is not a RIFF WAVE file";
+    case E_TUXDRV_WAVNODATA:
+        return "The wave file has no format or no data chunk";
+    case E_TUXDRV_WAVBADFORMAT:
+        return "The wave file must be PCM, 8000 Hz, mono, 8 bits";
     default:
         return "Unknow error";
     }
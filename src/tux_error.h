@@ -47,6 +47,10 @@ typedef enum
     E_TUXDRV_INVALIDPARAMETER, /**< Invalid command parameter */
     E_TUXDRV_BUSY, /**< Tuxdriver is busy */
     E_TUXDRV_WAVSIZEEXCEDED, /**< Wave size exceded (for sound flash) */
+    E_TUXDRV_WAVNOTFOUND, /**< Wave file can't be read */
+    E_TUXDRV_WAVNOTRIFF, /**< Not a RIFF WAVE file */
+    E_TUXDRV_WAVNODATA, /**< Wave file without fmt or data chunk */
+    E_TUXDRV_WAVBADFORMAT, /**< Wave format not supported by the flash */
 } tux_drv_error_t;
 
 extern const char *tux_error_strerror(TuxDrvError error_code);
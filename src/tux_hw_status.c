@@ -21,29 +21,147 @@
 #include <string.h>
 
 #include "log.h"
+#include "tux_battery.h"
+#include "tux_eyes.h"
+#include "tux_firmware.h"
+#include "tux_flippers.h"
 #include "tux_hw_status.h"
+#include "tux_id.h"
+#include "tux_leds.h"
+#include "tux_light.h"
 #include "tux_misc.h"
+#include "tux_mouth.h"
+#include "tux_pong.h"
+#include "tux_sound_flash.h"
+#include "tux_spinning.h"
+#include "tux_tracer.h"
+#include "tux_user_inputs.h"
+
+/** \brief Maximal number of updaters of a frame */
+#define FRAME_UPDATERS_MAX              8
+
+/**
+ * \brief Function updating the software statuses from a frame body.
+ */
+typedef struct
+{
+    unsigned char fields;   /**< Source fields (FRAME_FIELD_*) */
+    void (*update)(void);   /**< Updater */
+} frame_updater_t;
+
+/**
+ * \brief Description of a status frame.
+ * The payload of a frame is packed in a word, the byte 1 in the low byte,
+ * so a body is compared in one operation with the last one received.
+ */
+typedef struct
+{
+    unsigned char header;   /**< Frame header */
+    unsigned char *body;    /**< Body in the hardware status table */
+    unsigned char size;     /**< Meaningful bytes of the payload */
+    frame_updater_t updaters[FRAME_UPDATERS_MAX]; /**< Ended by a NULL */
+} frame_descriptor_t;
 
 LIBLOCAL hw_status_table_t hw_status_table;
-LIBLOCAL unsigned char tux_hw_status_header_counter[16] = { 0, 0, 0, 0, 0, 0,
+LIBLOCAL unsigned int tux_hw_status_header_counter[16] = { 0, 0, 0, 0, 0, 0,
                 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-static int parse_body_ports(const unsigned char *frame);
-static int parse_body_sensors1(const unsigned char *frame);
-static int parse_body_light(const unsigned char *frame);
-static int parse_body_position1(const unsigned char *frame);
-static int parse_body_position2(const unsigned char *frame);
-static int parse_body_ir(const unsigned char *frame);
-static int parse_body_id(const unsigned char *frame);
-static int parse_body_battery(const unsigned char *frame);
-static int parse_body_version(const unsigned char *frame);
-static int parse_body_revision(const unsigned char *frame);
-static int parse_body_author(const unsigned char *frame);
-static int parse_body_audio(const unsigned char *frame);
-static int parse_body_sound_var(const unsigned char *frame);
-static int parse_body_flash_prog(const unsigned char *frame);
-static int parse_body_led(const unsigned char *frame);
-static int parse_body_pong(const unsigned char *frame);
+/**
+ * \brief Frame descriptors, indexed by the low nibble of the header
+ * (headers_id_t).
+ */
+static const frame_descriptor_t frame_descriptors[16] = {
+    /* ID_FRAME_HEADER_PORTS */
+    {FRAME_HEADER_PORTS, (unsigned char *)&hw_status_table.ports, 3, {
+        {FRAME_FIELDS_ALL, tux_spinning_update_direction},
+        {FRAME_FIELD_1, tux_mouth_update_position},
+        {FRAME_FIELD_3, tux_eyes_update_position},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_SENSORS1 */
+    {FRAME_HEADER_SENSORS1, (unsigned char *)&hw_status_table.sensors1, 3, {
+        {FRAME_FIELD_2 | FRAME_FIELD_3, tux_sound_flash_update_general_play},
+        {FRAME_FIELD_1, tux_user_inputs_update_head_button},
+        {FRAME_FIELD_1, tux_user_inputs_update_left_wing_button},
+        {FRAME_FIELD_1, tux_user_inputs_update_right_wing_button},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_LIGHT */
+    {FRAME_HEADER_LIGHT, (unsigned char *)&hw_status_table.light, 3, {
+        {FRAME_FIELDS_ALL, tux_light_update_level},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_POSITION1 */
+    {FRAME_HEADER_POSITION1, (unsigned char *)&hw_status_table.position1, 3, {
+        {FRAME_FIELD_3, tux_flippers_update_movements_remaining},
+        {FRAME_FIELD_2, tux_mouth_update_movements_remaining},
+        {FRAME_FIELD_1, tux_eyes_update_movements_remaining},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_POSITION2 */
+    {FRAME_HEADER_POSITION2, (unsigned char *)&hw_status_table.position2, 3, {
+        {FRAME_FIELD_2, tux_flippers_update_position},
+        {FRAME_FIELD_1, tux_spinning_update_movements_remaining},
+        {FRAME_FIELD_3, tux_eyes_update_motor},
+        {FRAME_FIELD_3, tux_mouth_update_motor},
+        {FRAME_FIELD_3, tux_flippers_update_motor},
+        {FRAME_FIELD_3, tux_spinning_update_left_motor},
+        {FRAME_FIELD_3, tux_spinning_update_right_motor},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_IR */
+    {FRAME_HEADER_IR, (unsigned char *)&hw_status_table.ir, 1, {
+        {FRAME_FIELDS_ALWAYS, tux_user_inputs_init_time_RC5},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_ID */
+    {FRAME_HEADER_ID, (unsigned char *)&hw_status_table.id, 2, {
+        {FRAME_FIELDS_ALWAYS, tux_id_update_number},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_BATTERY */
+    {FRAME_HEADER_BATTERY, (unsigned char *)&hw_status_table.battery, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_user_inputs_update_charger_state},
+        {FRAME_FIELDS_ALL, tux_battery_update_level},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_VERSION */
+    {FRAME_HEADER_VERSION, (unsigned char *)&hw_status_table.version, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_firmware_update_version},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_REVISION */
+    {FRAME_HEADER_REVISION, (unsigned char *)&hw_status_table.revision, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_firmware_update_revision},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_AUTHOR */
+    {FRAME_HEADER_AUTHOR, (unsigned char *)&hw_status_table.author, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_firmware_update_author},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_SOUND_VAR */
+    {FRAME_HEADER_SOUND_VAR, (unsigned char *)&hw_status_table.sound_var, 2, {
+        {FRAME_FIELDS_ALWAYS, tux_sound_flash_update},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_AUDIO */
+    {FRAME_HEADER_AUDIO, (unsigned char *)&hw_status_table.audio, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_sound_flash_update_flash_play},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_FLASH_PROG */
+    {FRAME_HEADER_FLASH_PROG, (unsigned char *)&hw_status_table.flash_prog, 2, {
+        /* Don't work ...
+        {FRAME_FIELD_1, tux_sound_flash_update_prog_current_track},
+        {FRAME_FIELD_2, tux_sound_flash_update_prog_last_track_size},
+        */
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_LED */
+    {FRAME_HEADER_LED, (unsigned char *)&hw_status_table.led, 3, {
+        {FRAME_FIELD_1 | FRAME_FIELD_3, tux_leds_update_left},
+        {FRAME_FIELD_2 | FRAME_FIELD_3, tux_leds_update_right},
+        {0, NULL}}},
+    /* ID_FRAME_HEADER_PONG */
+    {FRAME_HEADER_PONG, (unsigned char *)&hw_status_table.pong, 3, {
+        {FRAME_FIELDS_ALWAYS, tux_pong_update},
+        {0, NULL}}},
+};
+
+/** \brief Masks of the meaningful bytes of a packed payload, by size */
+static const unsigned int payload_masks[4] = {
+    0x000000, 0x0000FF, 0x00FFFF, 0xFFFFFF
+};
+
+/** \brief Last payload received of each frame, packed */
+static unsigned int last_payloads[16];
 
 /**
  *
@@ -52,66 +170,99 @@ LIBLOCAL void
 tux_hw_status_init(void)
 {
     memset(&hw_status_table, 0, sizeof(hw_status_table_t));
+    memset(last_payloads, 0, sizeof(last_payloads));
 }
 
 /**
- *
+ * \brief Get the descriptor of a frame.
+ * \param header Frame header.
+ * \return The descriptor, NULL if the header is unknown.
+ */
+static const frame_descriptor_t *
+get_descriptor(unsigned char header)
+{
+    const frame_descriptor_t *desc = &frame_descriptors[header & 0x0F];
+
+    if (desc->header != header)
+    {
+        return NULL;
+    }
+
+    return desc;
+}
+
+/**
+ * \brief Store the body of a frame in the hardware status table.
+ * \param desc Descriptor of the frame.
+ * \param frame Frame (4 bytes).
+ * \return The changed fields (FRAME_FIELD_*).
+ */
+static unsigned char
+decode_body(const frame_descriptor_t *desc, const unsigned char *frame)
+{
+    unsigned int payload;
+    unsigned int diff;
+    unsigned char changed = 0;
+    int id = desc->header & 0x0F;
+
+    payload = (frame[1] | (frame[2] << 8) | (frame[3] << 16))
+        & payload_masks[desc->size];
+    diff = payload ^ last_payloads[id];
+    if (diff == 0)
+    {
+        return 0;
+    }
+
+    if (diff & 0x0000FF)
+    {
+        changed |= FRAME_FIELD_1;
+    }
+    if (diff & 0x00FF00)
+    {
+        changed |= FRAME_FIELD_2;
+    }
+    if (diff & 0xFF0000)
+    {
+        changed |= FRAME_FIELD_3;
+    }
+    last_payloads[id] = payload;
+    memcpy(desc->body, &frame[1], desc->size);
+
+    return changed;
+}
+
+/**
+ * \brief Decode a status frame and update the software statuses from the
+ * fields which changed.
+ * \param frame Frame (4 bytes).
+ * \return The changed fields (FRAME_FIELD_*), -1 if the header is unknown.
  */
 LIBLOCAL int
 tux_hw_status_parse_frame(const unsigned char *frame)
 {
-    switch(frame[0]) {
-    case FRAME_HEADER_PORTS:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_PORTS]++;
-        return parse_body_ports(frame);
-    case FRAME_HEADER_SENSORS1:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_SENSORS1]++;
-        return parse_body_sensors1(frame);
-    case FRAME_HEADER_LIGHT:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_LIGHT]++;
-        return parse_body_light(frame);
-    case FRAME_HEADER_POSITION1:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_POSITION1]++;
-        return parse_body_position1(frame);
-    case FRAME_HEADER_POSITION2:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_POSITION2]++;
-        return parse_body_position2(frame);
-    case FRAME_HEADER_IR:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_IR]++;
-        return parse_body_ir(frame);
-    case FRAME_HEADER_ID:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_ID]++;
-        return parse_body_id(frame);
-    case FRAME_HEADER_BATTERY:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_BATTERY]++;
-        return parse_body_battery(frame);
-    case FRAME_HEADER_VERSION:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_VERSION]++;
-        return parse_body_version(frame);
-    case FRAME_HEADER_REVISION:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_REVISION]++;
-        return parse_body_revision(frame);
-    case FRAME_HEADER_AUTHOR:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_AUTHOR]++;
-        return parse_body_author(frame);
-    case FRAME_HEADER_AUDIO:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_AUDIO]++;
-        return parse_body_audio(frame);
-    case FRAME_HEADER_SOUND_VAR:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_SOUND_VAR]++;
-        return parse_body_sound_var(frame);
-    case FRAME_HEADER_FLASH_PROG:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_FLASH_PROG]++;
-        return parse_body_flash_prog(frame);
-    case FRAME_HEADER_LED:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_LED]++;
-        return parse_body_led(frame);
-    case FRAME_HEADER_PONG:
-        tux_hw_status_header_counter[ID_FRAME_HEADER_PONG]++;
-        return parse_body_pong(frame);
-    default:
+    const frame_descriptor_t *desc;
+    const frame_updater_t *updater;
+    unsigned char changed;
+
+    desc = get_descriptor(frame[0]);
+    if (desc == NULL)
+    {
         return -1;
     }
+
+    tux_hw_status_header_counter[frame[0] & 0x0F]++;
+    changed = decode_body(desc, frame);
+    tux_trace(TUX_TRACE_FRAME_DECODED, changed, frame, 4);
+
+    for (updater = desc->updaters; updater->update != NULL; updater++)
+    {
+        if (updater->fields & (changed | FRAME_FIELDS_ALWAYS))
+        {
+            updater->update();
+        }
+    }
+
+    return changed;
 }
 
 /**
@@ -165,21 +316,27 @@ LIBLOCAL void
 tux_hw_status_header_counter_check(void)
 {
     int i;
-    unsigned char p_count = 0;
+    unsigned int p_count = 0;
+
+    /* The sum is only needed by the debug message */
+    if (!log_enabled(LOG_LEVEL_DEBUG))
+    {
+        memset(tux_hw_status_header_counter, 0,
+            sizeof(tux_hw_status_header_counter));
+        return;
+    }
 
     for (i = 0; i < 16; i++)
     {
         p_count += tux_hw_status_header_counter[i];
     }
 
-    /* as there is only debug code in this for loop it might make sense
-       to have a guarding ifdef around the for loop to save a few cycles */
     if (p_count >= 15)
     {
-        log_debug("Frames counter (%d) :\n\t%s:[%d]\n\t%s:[%d]\n\
-                \r\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\
-                \r\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\
-                \r\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n\t%s:[%d]\n",
+        log_debug("Frames counter (%u) :\n\t%s:[%u]\n\t%s:[%u]\n\
+                \r\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\
+                \r\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\
+                \r\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n\t%s:[%u]\n",
             p_count,
             tux_hw_status_id_to_str(0), tux_hw_status_header_counter[0],
             tux_hw_status_id_to_str(1), tux_hw_status_header_counter[1],
@@ -199,248 +356,8 @@ tux_hw_status_header_counter_check(void)
             tux_hw_status_id_to_str(15), tux_hw_status_header_counter[15]);
     }
 
-    // use memset instead ?
-    for (i = 0; i < 16; i++)
-    {
-        tux_hw_status_header_counter[i] = 0;
-    }
-}
-
-/**
- *
- */
-static int
-parse_body_ports(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.ports.portb.Byte != frame[1])
-    {
-        ret = FRAME_HEADER_PORTS;
-    }
-    if (hw_status_table.ports.portc.Byte != frame[2])
-    {
-        ret = FRAME_HEADER_PORTS;
-    }
-    if (hw_status_table.ports.portd.Byte != frame[3])
-    {
-        ret = FRAME_HEADER_PORTS;
-    }
-
-    hw_status_table.ports.portb.Byte = frame[1];
-    hw_status_table.ports.portc.Byte = frame[2];
-    hw_status_table.ports.portd.Byte = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_sensors1(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.sensors1.sensors.Byte != frame[1])
-    {
-        ret = FRAME_HEADER_SENSORS1;
-    }
-    if (hw_status_table.sensors1.play_internal_sound != frame[2])
-    {
-        ret = FRAME_HEADER_SENSORS1;
-    }
-    if (hw_status_table.sensors1.play_general_sound != frame[3])
-    {
-        ret = FRAME_HEADER_SENSORS1;
-    }
-
-    hw_status_table.sensors1.sensors.Byte = frame[1];
-    hw_status_table.sensors1.play_internal_sound = frame[2];
-    hw_status_table.sensors1.play_general_sound = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_light(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.light.high_level != frame[1])
-    {
-        ret = FRAME_HEADER_LIGHT;
-    }
-    if (hw_status_table.light.low_level != frame[2])
-    {
-        ret = FRAME_HEADER_LIGHT;
-    }
-    if (hw_status_table.light.mode != frame[3])
-    {
-        ret = FRAME_HEADER_LIGHT;
-    }
-
-    hw_status_table.light.high_level = frame[1];
-    hw_status_table.light.low_level = frame[2];
-    hw_status_table.light.mode = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_position1(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.position1.eyes_remaining_mvm != frame[1])
-    {
-        ret = FRAME_HEADER_POSITION1;
-    }
-    if (hw_status_table.position1.mouth_remaining_mvm != frame[2])
-    {
-        ret = FRAME_HEADER_POSITION1;
-    }
-    if (hw_status_table.position1.flippers_remaining_mvm != frame[3])
-    {
-        ret = FRAME_HEADER_POSITION1;
-    }
-
-    hw_status_table.position1.eyes_remaining_mvm = frame[1];
-    hw_status_table.position1.mouth_remaining_mvm = frame[2];
-    hw_status_table.position1.flippers_remaining_mvm = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_position2(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.position2.spin_remaining_mvm != frame[1])
-    {
-        ret = FRAME_HEADER_POSITION2;
-    }
-    if (hw_status_table.position2.flippers_down != frame[2])
-    {
-        ret = FRAME_HEADER_POSITION2;
-    }
-    if (hw_status_table.position2.motors.Byte != frame[3])
-    {
-        ret = FRAME_HEADER_POSITION2;
-    }
-
-    hw_status_table.position2.spin_remaining_mvm = frame[1];
-    hw_status_table.position2.flippers_down = frame[2];
-    hw_status_table.position2.motors.Byte = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_ir(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.ir.rc5_code.Byte != frame[1])
-    {
-        ret = FRAME_HEADER_IR;
-    }
-
-    hw_status_table.ir.rc5_code.Byte = frame[1];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_id(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.id.msb_number != frame[1])
-    {
-        ret = FRAME_HEADER_ID;
-    }
-    if (hw_status_table.id.lsb_number != frame[2])
-    {
-        ret = FRAME_HEADER_ID;
-    }
-
-    hw_status_table.id.msb_number = frame[1];
-    hw_status_table.id.lsb_number = frame[2];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_battery(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.battery.high_level != frame[1])
-    {
-        ret = FRAME_HEADER_BATTERY;
-    }
-    if (hw_status_table.battery.low_level != frame[2])
-    {
-        ret = FRAME_HEADER_BATTERY;
-    }
-    if (hw_status_table.battery.motors_state != frame[3])
-    {
-        ret = FRAME_HEADER_BATTERY;
-    }
-
-    hw_status_table.battery.high_level = frame[1];
-    hw_status_table.battery.low_level = frame[2];
-    hw_status_table.battery.motors_state = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_version(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.version.cm.Byte != frame[1])
-    {
-        ret = FRAME_HEADER_VERSION;
-    }
-    if (hw_status_table.version.minor != frame[2])
-    {
-        ret = FRAME_HEADER_VERSION;
-    }
-    if (hw_status_table.version.update != frame[3])
-    {
-        ret = FRAME_HEADER_VERSION;
-    }
-
-    hw_status_table.version.cm.Byte = frame[1];
-    hw_status_table.version.minor = frame[2];
-    hw_status_table.version.update = frame[3];
-
-    return ret;
+    memset(tux_hw_status_header_counter, 0,
+        sizeof(tux_hw_status_header_counter));
 }
 
 /**
@@ -449,35 +366,7 @@ parse_body_version(const unsigned char *frame)
 LIBLOCAL void
 tux_hw_parse_body_version(const unsigned char *frame)
 {
-    parse_body_version(frame);
-}
-
-/**
- *
- */
-static int
-parse_body_revision(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.revision.lsb_number != frame[1])
-    {
-        ret = FRAME_HEADER_REVISION;
-    }
-    if (hw_status_table.revision.msb_number != frame[2])
-    {
-        ret = FRAME_HEADER_REVISION;
-    }
-    if (hw_status_table.revision.release_type.Byte != frame[3])
-    {
-        ret = FRAME_HEADER_REVISION;
-    }
-
-    hw_status_table.revision.lsb_number = frame[1];
-    hw_status_table.revision.msb_number = frame[2];
-    hw_status_table.revision.release_type.Byte = frame[3];
-
-    return ret;
+    decode_body(&frame_descriptors[ID_FRAME_HEADER_VERSION], frame);
 }
 
 /**
@@ -486,35 +375,7 @@ parse_body_revision(const unsigned char *frame)
 LIBLOCAL void
 tux_hw_parse_body_revision(const unsigned char *frame)
 {
-    parse_body_revision(frame);
-}
-
-/**
- *
- */
-static int
-parse_body_author(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.author.lsb_id != frame[1])
-    {
-        ret = FRAME_HEADER_AUTHOR;
-    }
-    if (hw_status_table.author.msb_id != frame[2])
-    {
-        ret = FRAME_HEADER_AUTHOR;
-    }
-    if (hw_status_table.author.variation_number != frame[3])
-    {
-        ret = FRAME_HEADER_AUTHOR;
-    }
-
-    hw_status_table.author.lsb_id = frame[1];
-    hw_status_table.author.msb_id = frame[2];
-    hw_status_table.author.variation_number = frame[3];
-
-    return ret;
+    decode_body(&frame_descriptors[ID_FRAME_HEADER_REVISION], frame);
 }
 
 /**
@@ -523,135 +384,5 @@ parse_body_author(const unsigned char *frame)
 LIBLOCAL void
 tux_hw_parse_body_author(const unsigned char *frame)
 {
-    parse_body_author(frame);
-}
-
-/**
- *
- */
-static int
-parse_body_audio(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.audio.sound_track_played != frame[1])
-    {
-        ret = FRAME_HEADER_AUDIO;
-    }
-    if (hw_status_table.audio.programming_steps.Byte != frame[2])
-    {
-        ret = FRAME_HEADER_AUDIO;
-    }
-    if (hw_status_table.audio.programmed_sound_track != frame[3])
-    {
-        ret = FRAME_HEADER_AUDIO;
-    }
-
-    hw_status_table.audio.sound_track_played = frame[1];
-    hw_status_table.audio.programming_steps.Byte = frame[2];
-    hw_status_table.audio.programmed_sound_track = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_sound_var(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.sound_var.number_of_sounds != frame[1])
-    {
-        ret = FRAME_HEADER_SOUND_VAR;
-    }
-    if (hw_status_table.sound_var.flash_usage != frame[2])
-    {
-        ret = FRAME_HEADER_SOUND_VAR;
-    }
-
-    hw_status_table.sound_var.number_of_sounds = frame[1];
-    hw_status_table.sound_var.flash_usage = frame[2];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_flash_prog(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.flash_prog.current_state != frame[1])
-    {
-        ret = FRAME_HEADER_FLASH_PROG;
-    }
-    if (hw_status_table.flash_prog.last_sound_size != frame[2])
-    {
-        ret = FRAME_HEADER_FLASH_PROG;
-    }
-
-    hw_status_table.flash_prog.current_state = frame[1];
-    hw_status_table.flash_prog.last_sound_size = frame[2];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_led(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.led.left_led_intensity != frame[1])
-    {
-        ret = FRAME_HEADER_LED;
-    }
-    if (hw_status_table.led.right_led_intensity != frame[2])
-    {
-        ret = FRAME_HEADER_LED;
-    }
-    if (hw_status_table.led.effect_status.Byte != frame[3])
-    {
-        ret = FRAME_HEADER_LED;
-    }
-
-    hw_status_table.led.left_led_intensity = frame[1];
-    hw_status_table.led.right_led_intensity = frame[2];
-    hw_status_table.led.effect_status.Byte = frame[3];
-
-    return ret;
-}
-
-/**
- *
- */
-static int
-parse_body_pong(const unsigned char *frame)
-{
-    int ret = 0;
-
-    if (hw_status_table.pong.pongs_pending_number != frame[1])
-    {
-        ret = FRAME_HEADER_PONG;
-    }
-    if (hw_status_table.pong.pongs_lost_by_i2c_number != frame[2])
-    {
-        ret = FRAME_HEADER_PONG;
-    }
-    if (hw_status_table.pong.pongs_lost_by_rf_number != frame[3])
-    {
-        ret = FRAME_HEADER_PONG;
-    }
-
-    hw_status_table.pong.pongs_pending_number = frame[1];
-    hw_status_table.pong.pongs_lost_by_i2c_number = frame[2];
-    hw_status_table.pong.pongs_lost_by_rf_number = frame[3];
-
-    return ret;
+    decode_body(&frame_descriptors[ID_FRAME_HEADER_AUTHOR], frame);
 }
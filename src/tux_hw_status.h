@@ -38,6 +38,14 @@
 #define FRAME_HEADER_LED                0xCE
 #define FRAME_HEADER_PONG               0xFF
 
+/** \brief Changed fields of a frame, one bit per byte of the payload */
+#define FRAME_FIELD_1                   0x01
+#define FRAME_FIELD_2                   0x02
+#define FRAME_FIELD_3                   0x04
+#define FRAME_FIELDS_ALL                0x07
+/** \brief Updater called on each frame, changed or not */
+#define FRAME_FIELDS_ALWAYS             0x80
+
 typedef enum
 {
     ID_FRAME_HEADER_PORTS = 0,
@@ -351,7 +359,7 @@ typedef struct
 } hw_status_table_t;
 
 extern hw_status_table_t hw_status_table;
-extern unsigned char tux_hw_status_header_counter[16];
+extern unsigned int tux_hw_status_header_counter[16];
 
 extern void tux_hw_status_init(void);
 extern int tux_hw_status_parse_frame(const unsigned char *frame);
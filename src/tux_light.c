@@ -18,7 +18,6 @@
  * 02111-1307, USA.
  */
 
-#include <math.h>
 #include <string.h>
 
 #include "tux_hw_status.h"
@@ -26,8 +25,6 @@
 #include "tux_misc.h"
 #include "tux_sw_status.h"
 
-static float last_level_for_event = 0.0;
-
 /**
  *
  */
@@ -50,13 +47,6 @@ tux_light_update_level(void)
 
     new_level = (light_value * 100.0) / 1128.0;
 
-    if (fabs(new_level - last_level_for_event) > 1.0)
-    {
-        last_level_for_event = new_level;
-        tux_sw_status_set_floatvalue(SW_ID_LIGHT_LEVEL, new_level, true);
-    }
-    else
-    {
-        tux_sw_status_set_floatvalue(SW_ID_LIGHT_LEVEL, new_level, false);
-    }
+    /* The event filter of the status holds the small changes */
+    tux_sw_status_set_floatvalue(SW_ID_LIGHT_LEVEL, new_level, true);
 }
@@ -28,6 +28,7 @@
 #   include <windows.h>
 #else
 #   include <sys/time.h>
+#   include <time.h>
 #endif
 
 #ifdef WIN32
@@ -82,11 +83,35 @@ gettimeofday(struct timeval *tv, struct timezone *tz)
 }
 #endif /* WIN32 */
 
+static void system_sleep(double seconds);
+static double get_virtual_time(void);
+static void virtual_sleep(double seconds);
+
 /**
- *
+ *  Time source and sleep function of the driver, published together.
  */
-LIBEXPORT double
-get_time(void)
+typedef struct {
+    time_source_t time_funct;
+    sleep_funct_t sleep_funct;
+} time_pair_t;
+
+/** Storage of the pairs, a new pair is written in the unused one */
+static time_pair_t time_pairs[2] = {
+    { get_system_time, system_sleep },
+    { get_system_time, system_sleep },
+};
+/** Pair in use, only replaced while the driver is stopped */
+static time_pair_t *volatile time_pair = &time_pairs[0];
+/** Current time of the built-in virtual clock (nanoseconds), it can be
+ *  advanced by several threads */
+static volatile int64_t virtual_time_ns = 0;
+
+/**
+ *  Get the time of the system clock.
+ *  @return The time in seconds.
+ */
+LIBLOCAL double
+get_system_time(void)
 {
     double result;
     struct timeval tv;
@@ -98,6 +123,144 @@ get_time(void)
     return result;
 }
 
+/**
+ *  Get a monotonic time, not affected by the changes of the system clock.
+ *  When another time source is plugged, its time is returned instead.
+ *  @return The time in seconds.
+ */
+LIBLOCAL double
+get_monotonic_time(void)
+{
+#ifdef WIN32
+    LARGE_INTEGER counter, frequency;
+#else
+    struct timespec ts;
+#endif
+
+    time_pair_t *pair = time_pair;
+
+    if (pair->time_funct != get_system_time)
+    {
+        return pair->time_funct();
+    }
+#ifdef WIN32
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+#endif
+}
+
+/**
+ *  Sleep on the system clock.
+ *  @param seconds Duration to wait.
+ */
+static void
+system_sleep(double seconds)
+{
+#ifdef WIN32
+    Sleep((DWORD)(seconds * 1000));
+#else
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1000000000.0);
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/**
+ *  Get the time of the built-in virtual clock.
+ *  @return The time in seconds.
+ */
+static double
+get_virtual_time(void)
+{
+    return (double)__sync_fetch_and_add(&virtual_time_ns, 0) / 1000000000.0;
+}
+
+/**
+ *  Sleep on the built-in virtual clock : the clock jumps forward.
+ *  @param seconds Duration to wait.
+ */
+static void
+virtual_sleep(double seconds)
+{
+    __sync_fetch_and_add(&virtual_time_ns, (int64_t)(seconds * 1000000000.0));
+}
+
+/**
+ *  Get the current time from the time source of the driver.
+ *  @return The time in seconds.
+ */
+LIBEXPORT double
+get_time(void)
+{
+    return time_pair->time_funct();
+}
+
+/**
+ *  Wait a duration with the sleep function of the driver.
+ *  @param seconds Duration to wait.
+ */
+LIBLOCAL void
+wait_seconds(double seconds)
+{
+    if (seconds > 0.0)
+    {
+        time_pair->sleep_funct(seconds);
+    }
+}
+
+/**
+ *  Set the time source and the sleep function of the driver. The pair is
+ *  published at once, so a reader never mixes two sources. Must not be
+ *  called while the driver runs.
+ *  @param time_funct Time source (NULL for the system clock).
+ *  @param sleep_funct Sleep function (NULL for the system clock).
+ */
+LIBLOCAL void
+set_time_source(time_source_t time_funct, sleep_funct_t sleep_funct)
+{
+    time_pair_t *pair;
+
+    pair = (time_pair == &time_pairs[0]) ? &time_pairs[1] : &time_pairs[0];
+    pair->time_funct = (time_funct != NULL) ? time_funct : get_system_time;
+    pair->sleep_funct = (sleep_funct != NULL) ? sleep_funct : system_sleep;
+    __sync_synchronize();
+    time_pair = pair;
+}
+
+/**
+ *  Get the time source and the sleep function of the driver.
+ *  @param time_funct Output time source.
+ *  @param sleep_funct Output sleep function.
+ */
+LIBLOCAL void
+get_time_source(time_source_t *time_funct, sleep_funct_t *sleep_funct)
+{
+    time_pair_t *pair = time_pair;
+
+    *time_funct = pair->time_funct;
+    *sleep_funct = pair->sleep_funct;
+}
+
+/**
+ *  Use the built-in virtual clock as time source. The virtual time only
+ *  moves forward when the driver sleeps, so the timings run as fast as the
+ *  code does.
+ *  @param start_time Initial time of the virtual clock.
+ */
+LIBLOCAL void
+set_virtual_time_source(double start_time)
+{
+    virtual_time_ns = (int64_t)(start_time * 1000000000.0);
+    __sync_synchronize();
+    set_time_source(get_virtual_time, virtual_sleep);
+}
+
 LIBLOCAL bool
 str_to_uint8(const char *str, unsigned char *dest)
 {
@@ -44,7 +44,23 @@
  */
 typedef void(*simple_callback_t)(void);
 
+/**
+ *      Time source prototype, returns the current time in seconds
+ */
+typedef double(*time_source_t)(void);
+
+/**
+ *      Sleep function prototype, waits a duration in seconds
+ */
+typedef void(*sleep_funct_t)(double seconds);
+
 extern double get_time(void);
+extern double get_system_time(void);
+extern double get_monotonic_time(void);
+extern void wait_seconds(double seconds);
+extern void set_time_source(time_source_t time_funct, sleep_funct_t sleep_funct);
+extern void get_time_source(time_source_t *time_funct, sleep_funct_t *sleep_funct);
+extern void set_virtual_time_source(double start_time);
 extern bool str_to_uint8(const char *str, unsigned char *dest);
 extern bool str_to_int8(const char *str, char *dest);
 extern bool str_to_int(const char *str, int *dest);
@@ -18,95 +18,338 @@
  * 02111-1307, USA.
  */
 
+/**
+ * \file tux_pong.c
+ * \brief Measurement of the quality of the RF link.
+ *
+ * Tux answers a ping command by a burst of pong frames. Each pong frame
+ * gives the pongs still pending and the pongs lost on the I2C bus and on
+ * the RF link since the ping. The results of the last bursts are kept in
+ * a sliding window, from which the connection quality is computed.
+ *
+ * The pings use the same RF link as the commands, so a burst is only sent
+ * after some read cycles without any write, within a budget of pings per
+ * second.
+ */
+
+#include <string.h>
+
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
+
 #include "tux_hw_status.h"
 #include "tux_hw_cmd.h"
+#include "tux_misc.h"
 #include "tux_pong.h"
+#include "tux_sound_flash.h"
+#include "tux_stats.h"
 #include "tux_sw_status.h"
 #include "tux_types.h"
 #include "tux_usb.h"
 
-#define STACK_SIZE 10
+/** \brief Cycles without write needed before a burst */
+#define PONG_IDLE_CYCLES        3
+/** \brief Time left to a burst to complete, plus PONG_TIMEOUT_PER_PONG by
+ * pong (seconds) */
+#define PONG_BURST_TIMEOUT      1.0
+#define PONG_TIMEOUT_PER_PONG   0.05
+/** \brief Pings saved while the link is busy */
+#define PONG_MAX_TOKENS         2.0
+
+/**
+ * \brief Result of a burst of pongs.
+ */
+typedef struct {
+    unsigned int requested;     /**< Pongs requested by the ping */
+    unsigned int received;      /**< Pong frames received */
+    unsigned int lost_by_rf;    /**< Pongs lost on the RF link */
+    unsigned int lost_by_i2c;   /**< Pongs lost on the I2C bus */
+    double latency;             /**< Delay of the first pong (seconds) */
+} pong_burst_t;
 
-static int average_stack[STACK_SIZE];
-static unsigned char stack_idx = 0;
-static unsigned char stack_fill_count = 0;
+/** \brief Last bursts completed */
+static pong_burst_t window[PONG_WINDOW_SIZE];
+static int window_idx = 0;
+static int window_fill = 0;
+/** \brief Burst in progress */
+static pong_burst_t burst;
+static bool burst_running = false;
+static double burst_start = 0.0;
+/** \brief Pongs still pending in the last pong frame */
+static unsigned int last_pending = 0;
+
+/** \brief Budget of pings per second, 0 to disable the measurement */
+static float ping_rate = PONG_DEFAULT_RATE;
+/** \brief Pongs requested by each ping */
+static unsigned int burst_size = PONG_DEFAULT_BURST;
+/** \brief Pings which can be sent now, one per burst whatever its size */
+static double tokens = 0.0;
+static double tokens_time = 0.0;
+/** \brief Writes seen at the last cycle, and cycles since the last one */
+static uint64_t last_writes = 0;
+static int idle_cycles = 0;
+
+static bool pong_ready = false;
+#ifdef USE_MUTEX
+static mutex_t __pong_mutex;
+#endif
 
 /**
- *
+ * \brief Initialize the link quality measurement.
  */
-static void
-stack_insert(int value)
+LIBLOCAL void
+tux_pong_init(void)
 {
-    if (value > 100)
+    if (!pong_ready)
     {
-        value = 100;
+#ifdef USE_MUTEX
+        mutex_init(__pong_mutex);
+#endif
+        pong_ready = true;
     }
+    tux_pong_reset();
+}
+
+/**
+ * \brief Forget the bursts measured, when the RF link changes.
+ */
+LIBLOCAL void
+tux_pong_reset(void)
+{
+#ifdef USE_MUTEX
+    mutex_lock(__pong_mutex);
+#endif
+    window_idx = 0;
+    window_fill = 0;
+    burst_running = false;
+    last_pending = 0;
+    tokens = 0.0;
+    tokens_time = get_time();
+    idle_cycles = 0;
+#ifdef USE_MUTEX
+    mutex_unlock(__pong_mutex);
+#endif
+}
 
-    average_stack[stack_idx] = value;
-    stack_idx++;
+/**
+ * \brief Compute the connection quality from the window.
+ * \return The quality in percent.
+ */
+static int
+window_quality(void)
+{
+    unsigned int requested = 0;
+    unsigned int received = 0;
+    int i;
 
-    if (stack_fill_count < STACK_SIZE)
+    for (i = 0; i < window_fill; i++)
+    {
+        requested += window[i].requested;
+        received += window[i].received;
+    }
+    if (requested == 0)
+    {
+        return 0;
+    }
+    if (received > requested)
     {
-        stack_fill_count++;
+        received = requested;
     }
 
-    stack_idx %= STACK_SIZE;
+    return (int)(received * 100 / requested);
 }
 
 /**
- *
+ * \brief Store the burst in progress in the window.
+ * \return The new connection quality.
  */
 static int
-stack_average(void)
+end_burst(void)
 {
-    unsigned char i;
-    int average = 0;
-
-    for (i = 0; i < stack_fill_count; i++)
+    burst_running = false;
+    window[window_idx] = burst;
+    window_idx = (window_idx + 1) % PONG_WINDOW_SIZE;
+    if (window_fill < PONG_WINDOW_SIZE)
     {
-        average += average_stack[i];
+        window_fill++;
     }
 
-    return (average / stack_fill_count);
+    return window_quality();
 }
 
 /**
- *
+ * \brief Count a pong frame.
+ * Called for each pong frame received.
  */
 LIBLOCAL void
 tux_pong_update(void)
 {
-    static unsigned char received_pong = 0;
-    int average;
+    int quality = -1;
 
-    received_pong++;
-
-    if (hw_status_table.pong.pongs_pending_number <= 190)
+#ifdef USE_MUTEX
+    mutex_lock(__pong_mutex);
+#endif
+    last_pending = hw_status_table.pong.pongs_pending_number;
+    if (burst_running)
     {
-        if (received_pong > 1)
+        if (burst.received == 0)
         {
-            stack_insert(received_pong * 10);
-            average = stack_average();
-            tux_sw_status_set_intvalue(SW_ID_CONNECTION_QUALITY, average, true);
+            burst.latency = get_time() - burst_start;
         }
-        received_pong = 0;
+        burst.received++;
+        burst.lost_by_rf = hw_status_table.pong.pongs_lost_by_rf_number;
+        burst.lost_by_i2c = hw_status_table.pong.pongs_lost_by_i2c_number;
+        if (last_pending == 0)
+        {
+            quality = end_burst();
+        }
+    }
+#ifdef USE_MUTEX
+    mutex_unlock(__pong_mutex);
+#endif
+
+    if (quality >= 0)
+    {
+        tux_sw_status_set_intvalue(SW_ID_CONNECTION_QUALITY, quality, true);
     }
 }
 
 /**
- *
+ * \brief Send the pings and close the bursts which timed out.
+ * Called at the end of each read cycle.
  */
 LIBLOCAL void
 tux_pong_get(void)
 {
-    static unsigned char get_count = 0;
-    data_frame frame = { TUX_PONG_PING_CMD, 200, 0, 0};
+    data_frame frame = { TUX_PONG_PING_CMD, 0, 0, 0};
+    uint64_t writes;
+    double now;
+    int quality = -1;
+    bool send = false;
+    bool reflashing;
+
+    now = get_time();
+    writes = tux_stats_get_counter(STATS_USB_WRITES);
+    reflashing = tux_sound_flash_is_reflashing();
+
+#ifdef USE_MUTEX
+    mutex_lock(__pong_mutex);
+#endif
+    /* Close a burst whose last pongs were lost */
+    if (burst_running && (now - burst_start > PONG_BURST_TIMEOUT +
+            burst.requested * PONG_TIMEOUT_PER_PONG))
+    {
+        quality = end_burst();
+    }
 
-    get_count++;
+    /* Refill the budget */
+    tokens += (now - tokens_time) * ping_rate;
+    tokens_time = now;
+    if (tokens > PONG_MAX_TOKENS)
+    {
+        tokens = PONG_MAX_TOKENS;
+    }
 
-    if (get_count >= 40)
+    /* Any other write, or a sound reflash, keeps the link busy */
+    if ((writes != last_writes) || reflashing)
+    {
+        idle_cycles = 0;
+    }
+    else if (idle_cycles < PONG_IDLE_CYCLES)
+    {
+        idle_cycles++;
+    }
+
+    if ((ping_rate > 0.0) && !burst_running &&
+        (idle_cycles >= PONG_IDLE_CYCLES) && (tokens >= 1.0) &&
+        tux_usb_get_rf_state())
+    {
+        tokens -= 1.0;
+        memset(&burst, 0, sizeof(burst));
+        burst.requested = burst_size;
+        burst_start = now;
+        burst_running = true;
+        frame[1] = (unsigned char)burst_size;
+        send = true;
+    }
+#ifdef USE_MUTEX
+    mutex_unlock(__pong_mutex);
+#endif
+
+    if (quality >= 0)
+    {
+        tux_sw_status_set_intvalue(SW_ID_CONNECTION_QUALITY, quality, true);
+    }
+    if (send)
     {
-        get_count = 0;
         tux_usb_send_to_tux(frame);
     }
+    /* The ping itself is not a traffic */
+    last_writes = tux_stats_get_counter(STATS_USB_WRITES);
+}
+
+/**
+ * \brief Set the budget of the pings.
+ * \param rate Pings per second, 0 to stop the measurement.
+ * \param size Pongs requested by each ping.
+ * \return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_pong_set_rate(float rate, int size)
+{
+    if ((rate < 0.0) || (size < 1) || (size > PONG_MAX_BURST))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__pong_mutex);
+#endif
+    ping_rate = rate;
+    burst_size = size;
+#ifdef USE_MUTEX
+    mutex_unlock(__pong_mutex);
+#endif
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * \brief Get the measures of the link over the window.
+ * \param quality Output measures.
+ */
+LIBLOCAL void
+tux_pong_get_quality(link_quality_t *quality)
+{
+    unsigned int requested = 0;
+    unsigned int lost_by_rf = 0;
+    unsigned int lost_by_i2c = 0;
+    double latency = 0.0;
+    int answered = 0;
+    int i;
+
+#ifdef USE_MUTEX
+    mutex_lock(__pong_mutex);
+#endif
+    for (i = 0; i < window_fill; i++)
+    {
+        requested += window[i].requested;
+        lost_by_rf += window[i].lost_by_rf;
+        lost_by_i2c += window[i].lost_by_i2c;
+        if (window[i].received > 0)
+        {
+            latency += window[i].latency;
+            answered++;
+        }
+    }
+    quality->quality = window_quality();
+    quality->rf_loss = requested ? (float)lost_by_rf / requested : 0.0;
+    quality->i2c_loss = requested ? (float)lost_by_i2c / requested : 0.0;
+    quality->latency = answered ? (float)(latency / answered) : 0.0;
+    quality->pending = last_pending;
+    quality->bursts = window_fill;
+#ifdef USE_MUTEX
+    mutex_unlock(__pong_mutex);
+#endif
 }
@@ -21,7 +21,34 @@
 #ifndef _TUX_PONG_H_
 #define _TUX_PONG_H_
 
+#include "tux_error.h"
+
+/** \brief Bursts kept to compute the quality */
+#define PONG_WINDOW_SIZE        8
+/** \brief Default budget of pings per second, one burst every 4 seconds */
+#define PONG_DEFAULT_RATE       0.25
+/** \brief Default pongs requested by a ping */
+#define PONG_DEFAULT_BURST      10
+/** \brief Maximal pongs requested by a ping */
+#define PONG_MAX_BURST          200
+
+/**
+ * \brief Measures of the RF link.
+ */
+typedef struct {
+    int quality;            /**< Pongs received in percent */
+    float rf_loss;          /**< Ratio of the pongs lost on the RF link */
+    float i2c_loss;         /**< Ratio of the pongs lost on the I2C bus */
+    float latency;          /**< Mean delay of the first pong (seconds) */
+    unsigned int pending;   /**< Pongs pending in the last pong frame */
+    int bursts;             /**< Bursts in the window */
+} link_quality_t;
+
+extern void tux_pong_init(void);
+extern void tux_pong_reset(void);
 extern void tux_pong_update(void);
 extern void tux_pong_get(void);
+extern TuxDrvError tux_pong_set_rate(float rate, int size);
+extern void tux_pong_get_quality(link_quality_t *quality);
 
 #endif /* _TUX_PONG_H_ */
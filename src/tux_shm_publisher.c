@@ -0,0 +1,357 @@
+/*
+ * Tux Droid - Status shared memory publisher
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_shm_publisher.c
+ * \brief Status shared memory publisher functions.
+ * \ingroup sw_status
+ *
+ * The statuses are copied in a POSIX shared memory segment at the end of
+ * each read cycle, so other processes can read them without the dongle.
+ * The segment is filled once before it is handed over to the read loop,
+ * which is then its only writer. The publisher mutex keeps the segment
+ * mapped while the read loop writes it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifndef WIN32
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <signal.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
+
+#include "../include/tux_status_shm.h"
+#include "log.h"
+#include "tux_misc.h"
+#include "tux_shm_publisher.h"
+#include "tux_stats.h"
+#include "tux_sw_status.h"
+
+#ifndef WIN32
+/** \brief Segment published by the read loop, NULL when stopped */
+static tux_status_shm_t *volatile segment = NULL;
+/** \brief Name of the segment */
+static char segment_name[256] = "";
+#ifdef USE_MUTEX
+/* The publisher only exists on POSIX, where a static initializer avoids
+ * racing on a lazy initialization */
+static mutex_t __publisher_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * \brief Start a modification of a segment.
+ */
+static void
+segment_write_begin(tux_status_shm_t *shm)
+{
+    shm->seq++;
+    __sync_synchronize();
+}
+
+/**
+ * \brief End a modification of a segment.
+ */
+static void
+segment_write_end(tux_status_shm_t *shm)
+{
+    __sync_synchronize();
+    shm->seq++;
+}
+
+/**
+ * \brief Copy the statuses and the frame counters in a segment.
+ * Must be called with the publisher mutex locked.
+ */
+static void
+publish_segment(tux_status_shm_t *shm)
+{
+    static status_snapshot_t snapshot;
+    static tux_stats_t stats;
+    tux_status_shm_entry_t *entry;
+    int i;
+
+    /* Read the table before, the segment stays odd for a short time */
+    tux_sw_status_get_snapshot(&snapshot);
+    tux_stats_get(&stats);
+
+    segment_write_begin(shm);
+    for (i = 0; i < SW_STATUS_NUMBER; i++)
+    {
+        entry = &shm->statuses[i];
+        entry->value_fmt = snapshot.values[i].value_fmt;
+        entry->intvalue = snapshot.values[i].intvalue;
+        entry->floatvalue = snapshot.values[i].floatvalue;
+        if (snapshot.values[i].strvalue != NULL)
+        {
+            snprintf(entry->strvalue, TUX_STATUS_SHM_STR_SIZE, "%s",
+                    snapshot.values[i].strvalue);
+        }
+        else
+        {
+            entry->strvalue[0] = '\0';
+        }
+        entry->lu_time = snapshot.values[i].lu_time;
+    }
+    for (i = 0; i < TUX_STATUS_SHM_FRAME_TYPES; i++)
+    {
+        shm->frame_counts[i] = stats.frames[i];
+    }
+    shm->cycle_count++;
+    shm->publish_time = get_time();
+    segment_write_end(shm);
+}
+
+/**
+ * \brief Check if an existing segment was left by a driver which is gone.
+ * \param name Name of the segment.
+ * \return True if the segment can be removed.
+ *
+ * An empty or uninitialized segment is stale. A segment of another layout
+ * version doesn't tell its publisher, so it is kept.
+ */
+static bool
+segment_is_stale(const char *name)
+{
+    tux_status_shm_t *shm;
+    struct stat st;
+    bool stale = false;
+    pid_t pid;
+    void *map;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        /* Removed meanwhile */
+        return true;
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size < (off_t)sizeof(tux_status_shm_t))
+    {
+        close(fd);
+        return (st.st_size == 0);
+    }
+    map = mmap(NULL, sizeof(tux_status_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    shm = (tux_status_shm_t *)map;
+    if (shm->magic != TUX_STATUS_SHM_MAGIC)
+    {
+        stale = true;
+    }
+    else if (shm->version == TUX_STATUS_SHM_VERSION)
+    {
+        pid = (pid_t)shm->publisher_pid;
+        /* Our own segment is only left here by a failed stop */
+        stale = (pid == getpid()) ||
+            ((kill(pid, 0) < 0) && (errno == ESRCH));
+    }
+    munmap(map, sizeof(tux_status_shm_t));
+
+    return stale;
+}
+#endif
+
+/**
+ * \brief Create the shared memory segment and publish the statuses.
+ * \param name Name of the segment, NULL for TUX_STATUS_SHM_NAME.
+ * \return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_shm_publisher_start(const char *name)
+{
+#ifdef WIN32
+    (void)name;
+    return E_TUXDRV_FILEERROR;
+#else
+    tux_status_shm_t *shm;
+    int fd;
+    int i;
+    void *map;
+
+    if (segment != NULL)
+    {
+        return E_TUXDRV_BUSY;
+    }
+    if (name == NULL)
+    {
+        name = TUX_STATUS_SHM_NAME;
+    }
+    if ((name[0] != '/') || (strlen(name) >= sizeof(segment_name)))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if ((fd < 0) && (errno == EEXIST))
+    {
+        /* A segment left by a crash may hold an odd sequence number, one
+         * of a running driver is kept for its readers */
+        if (!segment_is_stale(name))
+        {
+            log_error("The status shared memory %s is used by another "
+                "driver", name);
+            return E_TUXDRV_BUSY;
+        }
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if ((fd < 0) && (errno == EEXIST))
+        {
+            return E_TUXDRV_BUSY;
+        }
+    }
+    if (fd < 0)
+    {
+        log_error("Can't create the status shared memory %s", name);
+        return E_TUXDRV_FILEERROR;
+    }
+    if (ftruncate(fd, sizeof(tux_status_shm_t)) < 0)
+    {
+        log_error("Can't size the status shared memory %s", name);
+        close(fd);
+        shm_unlink(name);
+        return E_TUXDRV_FILEERROR;
+    }
+    map = mmap(NULL, sizeof(tux_status_shm_t), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        log_error("Can't map the status shared memory %s", name);
+        shm_unlink(name);
+        return E_TUXDRV_FILEERROR;
+    }
+
+    shm = (tux_status_shm_t *)map;
+    strcpy(segment_name, name);
+
+    /* The names are written once, the magic number tells they are valid */
+    shm->seq = 0;
+    segment_write_begin(shm);
+    shm->version = TUX_STATUS_SHM_VERSION;
+    shm->status_count = SW_STATUS_NUMBER;
+    shm->publisher_pid = (uint32_t)getpid();
+    shm->reserved = 0;
+    shm->cycle_count = 0;
+    memset(shm->frame_counts, 0, sizeof(shm->frame_counts));
+    for (i = 0; i < SW_STATUS_NUMBER; i++)
+    {
+        char status_name[128] = "";
+
+        tux_sw_status_name_from_id(i, status_name);
+        snprintf(shm->statuses[i].name, TUX_STATUS_SHM_NAME_SIZE, "%s",
+                status_name);
+    }
+    shm->magic = TUX_STATUS_SHM_MAGIC;
+    segment_write_end(shm);
+
+    /* Hand the filled segment over to the read loop */
+#ifdef USE_MUTEX
+    mutex_lock(__publisher_mutex);
+#endif
+    publish_segment(shm);
+    segment = shm;
+#ifdef USE_MUTEX
+    mutex_unlock(__publisher_mutex);
+#endif
+    log_info("Statuses published in %s", name);
+
+    return E_TUXDRV_NOERROR;
+#endif
+}
+
+/**
+ * \brief Remove the shared memory segment.
+ * The mapped readers keep their view until they close it.
+ */
+LIBLOCAL void
+tux_shm_publisher_stop(void)
+{
+#ifndef WIN32
+    tux_status_shm_t *shm;
+
+    if (segment == NULL)
+    {
+        return;
+    }
+
+    /* Take the segment back from the read loop */
+#ifdef USE_MUTEX
+    mutex_lock(__publisher_mutex);
+#endif
+    shm = segment;
+    segment = NULL;
+#ifdef USE_MUTEX
+    mutex_unlock(__publisher_mutex);
+#endif
+    if (shm == NULL)
+    {
+        return;
+    }
+
+    segment_write_begin(shm);
+    shm->magic = 0;
+    segment_write_end(shm);
+    munmap(shm, sizeof(tux_status_shm_t));
+    shm_unlink(segment_name);
+#endif
+}
+
+/**
+ * \brief Copy the statuses and the frame counters in the segment.
+ * Called at the end of each read cycle, by the read loop only.
+ */
+LIBLOCAL void
+tux_shm_publisher_publish(void)
+{
+#ifndef WIN32
+    if (segment == NULL)
+    {
+        return;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__publisher_mutex);
+#endif
+    if (segment != NULL)
+    {
+        publish_segment(segment);
+    }
+#ifdef USE_MUTEX
+    mutex_unlock(__publisher_mutex);
+#endif
+#endif
+}
@@ -0,0 +1,36 @@
+/*
+ * Tux Droid - Status shared memory publisher
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_shm_publisher.h
+ * \brief Status shared memory publisher header.
+ * \ingroup sw_status
+ */
+
+#ifndef _TUX_SHM_PUBLISHER_H_
+#define _TUX_SHM_PUBLISHER_H_
+
+#include "tux_error.h"
+
+extern TuxDrvError tux_shm_publisher_start(const char *name);
+extern void tux_shm_publisher_stop(void);
+extern void tux_shm_publisher_publish(void);
+
+#endif /* _TUX_SHM_PUBLISHER_H_ */
@@ -23,15 +23,22 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
+
 #include "log.h"
 #include "tux_cmd_parser.h"
 #include "tux_hw_status.h"
 #include "tux_hw_cmd.h"
 #include "tux_leds.h"
+#include "tux_misc.h"
 #include "tux_sw_status.h"
 #include "tux_sound_flash.h"
+#include "tux_sound_player.h"
 #include "tux_types.h"
 #include "tux_usb.h"
+#include "tux_wav.h"
 
 LIBLOCAL sound_flash_descriptor_t sound_flash_desc;
 
@@ -53,7 +60,10 @@ typedef enum {
     SRS_STDBY,
     SRS_INIT,
     SRS_ERASE,
-    SRS_WRITE,
+    SRS_STORE,
+    SRS_PLAY,
+    SRS_PLAYING,
+    SRS_CONFIRM,
     SRS_FINISH,
 } sound_reflash_state_t;
 
@@ -69,16 +79,31 @@ typedef struct {
     unsigned char wav_count;
     unsigned char current_wav;
     unsigned long full_size;
-    unsigned long wav_size[256];
+    tux_wav_t wavs[256]; /**< Mapped tracks, shared by the size checks and
+                              the playback */
+    int bad_track; /**< Track refused by the last reflash, from 1 */
     sound_reflash_errors_t error;
     sound_reflash_state_t current_state;
+    double deadline; /**< Monotonic time to leave the current state */
+    int track_progress; /**< Last progress event of the current track */
 } sound_reflash_info_t;
 
 static sound_reflash_info_t reflash_info;
 
+#ifdef USE_MUTEX
+/** \brief Thread playing the current track */
+static thread_t player_thread;
+/** \brief The player thread exists and has not been joined */
+static bool player_active = false;
+/** \brief The player thread still plays the track */
+static volatile bool player_running = false;
+#endif
+/** \brief Result of the last played track */
+static volatile bool player_result = false;
+
 static void load_knowed_track_num(void);
 static void init_reflash_info(void);
-static bool play_wav(const char *wav_path);
+static bool play_wav(int track);
 
 /**
  * Init the sound flash descriptor part.
@@ -489,14 +514,15 @@ get_hw_audio_device_name(void)
 #endif /* WIN32 || UNIX */
 
 /**
- *
+ * Play a track of the reflash.
  */
 static bool
-play_wav(const char *wav_path)
+play_wav(int track)
 {
     bool ret = true;
 
 #ifdef WIN32
+    const char *wav_path = reflash_info.wav_path[track];
     char def_dev_name[256] = "";
     int def_idx = -1;
 
@@ -522,7 +548,18 @@ play_wav(const char *wav_path)
         return false;
     }
 
+#elif defined(USE_ALSA)
+    ret = false;
+
+    if (hw_audio_name[0] != '\0')
+    {
+        ret = tux_sound_player_play(reflash_info.wavs[track].samples,
+            reflash_info.wavs[track].size, reflash_info.wavs[track].rate,
+            reflash_info.wavs[track].channels, reflash_info.wavs[track].bits);
+    }
+
 #else /* UNIX */
+    const char *wav_path = reflash_info.wav_path[track];
     int r;
     char cmd[256] = "";
 
@@ -540,6 +577,64 @@ play_wav(const char *wav_path)
     return ret;
 }
 
+#ifdef USE_MUTEX
+/**
+ * Thread playing a track, the playback lasts as long as the track.
+ */
+static callback_t
+player_loop(void *param)
+{
+    (void)param;
+
+    /* The current track doesn't change until the end of the playback */
+    player_result = play_wav(reflash_info.current_wav);
+    player_running = false;
+
+    return 0;
+}
+#endif
+
+/**
+ * Start to play a track of the reflash.
+ * Without thread support the track is played before the return.
+ */
+static void
+start_playback(void)
+{
+#ifdef USE_MUTEX
+    player_active = true;
+    player_running = true;
+    thread_create(player_thread, player_loop, NULL);
+#else
+    player_result = play_wav(reflash_info.current_wav);
+#endif
+}
+
+/**
+ * Check if the track of the reflash has been played.
+ * \param result Set to the result of the playback when finished.
+ * \return false while the track is played.
+ */
+static bool
+playback_finished(bool *result)
+{
+#ifdef USE_MUTEX
+    if (player_active)
+    {
+        if (player_running)
+        {
+            return false;
+        }
+        thread_wait_close(player_thread);
+        thread_delete(player_thread);
+        player_active = false;
+    }
+#endif
+    *result = player_result;
+
+    return true;
+}
+
 /**
  *
  */
@@ -561,12 +656,78 @@ parse_wavs(const char *src_str, tokens_t *toks)
 }
 
 /**
- *
+ * Release the mapped tracks of the reflash.
+ */
+static void
+release_wavs(void)
+{
+    int i;
+
+    for (i = 0; i < reflash_info.wav_count; i++)
+    {
+        tux_wav_close(&reflash_info.wavs[i]);
+    }
+}
+
+/**
+ * Map a track of the reflash and check it fits the sound flash.
+ */
+static TuxDrvError
+open_wav(int track)
+{
+    tux_wav_t *wav = &reflash_info.wavs[track];
+    TuxDrvError ret;
+
+    ret = tux_wav_open(reflash_info.wav_path[track], wav);
+    if (ret != E_TUXDRV_NOERROR)
+    {
+        return ret;
+    }
+    if ((wav->format != WAV_FORMAT_PCM) ||
+        (wav->rate != SOUND_FLASH_RATE) ||
+        (wav->channels != SOUND_FLASH_CHANNELS) ||
+        (wav->bits != SOUND_FLASH_BITS))
+    {
+        log_error("Sound reflash: %s is format %u, %u Hz, %u channels, "
+            "%u bits", reflash_info.wav_path[track], wav->format, wav->rate,
+            wav->channels, wav->bits);
+        tux_wav_close(wav);
+        return E_TUXDRV_WAVBADFORMAT;
+    }
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * Get the track refused by the last reflash request.
+ * \return The position of the track, from 1, or 0 if none was refused.
+ */
+LIBLOCAL int
+tux_sound_flash_get_bad_track(void)
+{
+    return reflash_info.bad_track;
+}
+
+/**
+ * Check if a reflash of the sound flash is running.
+ * The reflash owns the link with Tux until its end.
+ */
+LIBLOCAL bool
+tux_sound_flash_is_reflashing(void)
+{
+    return reflash_info.current_state != SRS_STDBY;
+}
+
+/**
+ * Start a reflash of the sound flash.
+ * \param tracks Paths of the wav files, separated by '|'.
+ * \return The error result. When a track is refused, its position is given
+ * by tux_sound_flash_get_bad_track.
  */
 LIBLOCAL TuxDrvError
 tux_sound_flash_cmd_reflash(const char *tracks)
 {
-    FILE *fp;
+    TuxDrvError ret;
     int i;
     int block_count = 0;
     int tmp_bc = 0;
@@ -588,21 +749,20 @@ tux_sound_flash_cmd_reflash(const char *tracks)
     {
         for (i = 0; i < reflash_info.wav_count; i++)
         {
-            /* open the wav file */
-            fp = fopen((char *)reflash_info.wav_path[i], "rb");
-            /* if wav_path not accessible then exit */
-            if (fp == NULL)
+            /* Map the wav file and find its samples */
+            ret = open_wav(i);
+            if (ret != E_TUXDRV_NOERROR)
             {
-                return E_TUXDRV_BADWAVFILE;
+                log_error("Sound reflash: track %d (%s) refused: %s", i + 1,
+                    reflash_info.wav_path[i], tux_error_strerror(ret));
+                reflash_info.bad_track = i + 1;
+                release_wavs();
+                return ret;
             }
-            /* Get the size of file */
-            fseek(fp, 0, SEEK_END);
-            reflash_info.wav_size[i] = ftell(fp) - 44;
-            fclose(fp);
-            reflash_info.full_size += reflash_info.wav_size[i];
+            reflash_info.full_size += reflash_info.wavs[i].size;
             /* Get the needed blocks number for this sound */
-            tmp_bc = (int)(reflash_info.wav_size[i] / 4000);
-            if ((int)(reflash_info.wav_size[i] % 4000) > 0)
+            tmp_bc = (int)(reflash_info.wavs[i].size / SOUND_FLASH_BLOCK_SIZE);
+            if ((int)(reflash_info.wavs[i].size % SOUND_FLASH_BLOCK_SIZE) > 0)
             {
                 tmp_bc++;
             }
@@ -614,6 +774,7 @@ tux_sound_flash_cmd_reflash(const char *tracks)
     /* If needed blocks exceeds 127 then fail */
     if (block_count > 127)
     {
+        release_wavs();
         return E_TUXDRV_WAVSIZEEXCEDED;
     }
 
@@ -625,14 +786,72 @@ tux_sound_flash_cmd_reflash(const char *tracks)
 }
 
 /**
- *
+ * Stop the reflash on an error, without waiting the current deadline.
+ */
+static void
+fail_reflash(sound_reflash_errors_t error)
+{
+    reflash_info.error = error;
+    reflash_info.current_state = SRS_FINISH;
+    reflash_info.deadline = 0.0;
+}
+
+/**
+ * Send a command frame to the Tux of the reflash.
+ * \return false, and the reflash goes to SRS_FINISH, on USB error.
+ */
+static bool
+send_reflash_frame(unsigned char cmd, unsigned char param)
+{
+    data_frame frame = {0, 0, 0, 0};
+
+    frame[0] = cmd;
+    frame[1] = param;
+    if (!tux_usb_send_to_tux(frame))
+    {
+        fail_reflash(SRE_USB_ERROR);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Send the progress of the current track when it has changed.
+ */
+static void
+update_track_progress(int progress)
+{
+    if (progress != reflash_info.track_progress)
+    {
+        reflash_info.track_progress = progress;
+        tux_sw_status_set_intvalue(SW_ID_SOUND_REFLASH_TRACK_PROGRESS,
+            progress, true);
+    }
+}
+
+/**
+ * Go to a state of the reflash after a delay.
+ * The read loop goes on during the delay.
+ */
+static void
+goto_state_after(sound_reflash_state_t state, double delay)
+{
+    reflash_info.current_state = state;
+    reflash_info.deadline = get_monotonic_time() + delay;
+}
+
+/**
+ * Sound reflash state machine, called at the end of each read cycle.
+ * A state never blocks: the waits are deadlines checked on the next
+ * cycles, and the tracks are played by a worker thread.
  */
 LIBLOCAL void
 tux_sound_flash_state_machine_call(void)
 {
     bool rf_state = false;
+    bool played = false;
     float full_time_sec = 0.0;
-    data_frame frame = {0, 0, 0, 0};
     unsigned char curr_track_for_event = 0;
 
     /* Check fux connection and radio connection */
@@ -641,11 +860,18 @@ tux_sound_flash_state_machine_call(void)
         rf_state = tux_usb_get_rf_state();
         if ((!tux_usb_connected()) || (!rf_state))
         {
-            reflash_info.error = SRE_RF_OFFLINE;
-            reflash_info.current_state = SRS_FINISH;
+            fail_reflash(SRE_RF_OFFLINE);
         }
     }
 
+    /* Wait the deadline of the current state */
+    if ((reflash_info.current_state != SRS_STDBY) &&
+        (reflash_info.current_state != SRS_FINISH) &&
+        (get_monotonic_time() < reflash_info.deadline))
+    {
+        return;
+    }
+
     switch (reflash_info.current_state) {
     case SRS_STDBY:
         break;
@@ -653,7 +879,8 @@ tux_sound_flash_state_machine_call(void)
         /* Disabling commands parsing */
         tux_cmd_parser_set_enable(false);
         /* Send begin flashing event with the fulltime of processing */
-        full_time_sec = 10.0 + (reflash_info.full_size / 8000.0);
+        full_time_sec = 10.0 + (reflash_info.full_size /
+            (float)(SOUND_FLASH_RATE * SOUND_FLASH_CHANNELS));
         full_time_sec += reflash_info.wav_count * 0.97;
         tux_sw_status_set_floatvalue(SW_ID_SOUND_REFLASH_BEGIN,
             full_time_sec, true);
@@ -670,71 +897,82 @@ tux_sound_flash_state_machine_call(void)
             FADE_DURATION, 0.5, 0);
         /* Send erase cmd */
         log_info("Sound reflash: Erasing");
-        frame[0] = ERASE_FLASH_CMD;
-        if (!tux_usb_send_to_tux(frame))
+        if (!send_reflash_frame(ERASE_FLASH_CMD, 0))
         {
-            reflash_info.error = SRE_USB_ERROR;
-            reflash_info.current_state = SRS_FINISH;
             break;
         }
-        /* Wait that the flash has been erased */
-        sleep(10);
-        /* Set first track to write */
+        /* Set first track to write once the flash has been erased */
         reflash_info.current_wav = 0;
-        /* Goto SRS_WRITE state */
-        reflash_info.current_state = SRS_WRITE;
+        goto_state_after(SRS_STORE, 10.0);
         break;
-    case SRS_WRITE:
+    case SRS_STORE:
         /* Send store sound command */
         log_info("Sound reflash: Store track (%d of %d)",
             reflash_info.current_wav + 1,
             reflash_info.wav_count);
-        frame[0] = STORE_SOUND_CMD;
-        if (!tux_usb_send_to_tux(frame))
+        if (!send_reflash_frame(STORE_SOUND_CMD, 0))
         {
-            reflash_info.error = SRE_USB_ERROR;
-            reflash_info.current_state = SRS_FINISH;
             break;
         }
         curr_track_for_event = reflash_info.current_wav + 1;
         tux_sw_status_set_intvalue(SW_ID_SOUND_REFLASH_CURRENT_TRACK,
             curr_track_for_event, true);
-        usleep(200000);
+        goto_state_after(SRS_PLAY, 0.2);
+        break;
+    case SRS_PLAY:
         /* Play current wav track */
-        if (!play_wav(reflash_info.wav_path[reflash_info.current_wav]))
+        reflash_info.track_progress = -1;
+        update_track_progress(0);
+        start_playback();
+        reflash_info.current_state = SRS_PLAYING;
+        break;
+    case SRS_PLAYING:
+        if (!playback_finished(&played))
+        {
+            update_track_progress(tux_sound_player_get_progress());
+            break;
+        }
+        if (!played)
         {
-            frame[0] = CONFIRM_STORAGE_CMD;
-            frame[1] = 0;
-            if (!tux_usb_send_to_tux(frame))
+            if (send_reflash_frame(CONFIRM_STORAGE_CMD, 0))
             {
-                reflash_info.error = SRE_USB_ERROR;
-                reflash_info.current_state = SRS_FINISH;
-                break;
+                fail_reflash(SRE_WAV_ERROR);
             }
-            reflash_info.error = SRE_WAV_ERROR;
-            reflash_info.current_state = SRS_FINISH;
             break;
         }
+        update_track_progress(100);
+        goto_state_after(SRS_CONFIRM, 0.2);
+        break;
+    case SRS_CONFIRM:
         /* Send confirm track command */
-        usleep(200000);
-        frame[0] = CONFIRM_STORAGE_CMD;
-        frame[1] = 1;
-        if (!tux_usb_send_to_tux(frame))
+        if (!send_reflash_frame(CONFIRM_STORAGE_CMD, 1))
         {
-            reflash_info.error = SRE_USB_ERROR;
-            reflash_info.current_state = SRS_FINISH;
             break;
         }
-        usleep(100000);
         /* Set next track to write */
         reflash_info.current_wav += 1;
         /* If the next track is out of limit, Goto SRS_FINISH state */
         if (reflash_info.current_wav >= reflash_info.wav_count)
         {
-            reflash_info.current_state = SRS_FINISH;
+            goto_state_after(SRS_FINISH, 0.1);
+        }
+        else
+        {
+            goto_state_after(SRS_STORE, 0.1);
         }
         break;
     case SRS_FINISH:
+        /* The track being played must end before a new reflash */
+        if (!playback_finished(&played))
+        {
+            break;
+        }
+        if (get_monotonic_time() < reflash_info.deadline)
+        {
+            break;
+        }
+        tux_sound_player_close();
+        release_wavs();
         /* Enabling commands parsing */
         tux_cmd_parser_set_enable(true);
         /* Leds stop */
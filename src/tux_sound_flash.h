@@ -25,6 +25,13 @@
 
 #include "tux_error.h"
 
+/** \brief Format of the sound flash tracks */
+#define SOUND_FLASH_RATE                8000
+#define SOUND_FLASH_CHANNELS            1
+#define SOUND_FLASH_BITS                8
+/** \brief Bytes of samples in a block of the sound flash */
+#define SOUND_FLASH_BLOCK_SIZE          4000
+
 typedef struct
 {
     unsigned int number_of_sounds;
@@ -48,6 +55,8 @@ extern bool tux_sound_flash_check_new_descriptor(bool save);
 extern bool tux_sound_flash_cmd_play(unsigned char track_num, float volume);
 extern void tux_sound_flash_state_machine_call(void);
 extern TuxDrvError tux_sound_flash_cmd_reflash(const char *tracks);
+extern int tux_sound_flash_get_bad_track(void);
+extern bool tux_sound_flash_is_reflashing(void);
 extern void tux_sound_flash_avoid_tts_default_sound_card(void);
 
 #endif /* _TUX_SOUND_FLASH_H_ */
@@ -0,0 +1,205 @@
+/*
+ * Tux Droid - Sound player
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_sound_player.c
+ * \brief ALSA playback of the sound reflash tracks functions.
+ *
+ * The device is opened once for a whole reflash and the samples are
+ * written from the caller's memory, without a copy nor a child process.
+ * The playback runs on the player thread of the reflash, the read loop
+ * only reads the progress. Without USE_ALSA the functions fail and the
+ * reflash plays the tracks with aplay.
+ */
+
+#ifdef USE_ALSA
+#   include <errno.h>
+#   include <alsa/asoundlib.h>
+#endif
+
+#include "log.h"
+#include "tux_misc.h"
+#include "tux_sound_player.h"
+
+#ifdef USE_ALSA
+/** \brief Opened device, NULL when closed */
+static snd_pcm_t *pcm = NULL;
+#endif
+/** \brief Frames of the current track */
+static volatile unsigned long track_frames = 0;
+/** \brief Frames of the current track written to the device */
+static volatile unsigned long played_frames = 0;
+
+/**
+ * \brief Open the Tux audio device.
+ * Nothing is done if the device is already opened.
+ * \return The success.
+ */
+LIBLOCAL bool
+tux_sound_player_open(void)
+{
+#ifdef USE_ALSA
+    int err;
+
+    if (pcm != NULL)
+    {
+        return true;
+    }
+
+    err = snd_pcm_open(&pcm, SOUND_PLAYER_DEVICE, SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        log_error("Can't open %s (%s)", SOUND_PLAYER_DEVICE,
+            snd_strerror(err));
+        pcm = NULL;
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * \brief Play PCM samples on the Tux audio device and wait their end.
+ * \param samples Interleaved samples, little endian.
+ * \param size Size of the samples in bytes.
+ * \param rate Sample rate.
+ * \param channels Number of channels.
+ * \param bits Bits per sample, 8 or 16.
+ * \return The success.
+ */
+LIBLOCAL bool
+tux_sound_player_play(const unsigned char *samples, unsigned long size,
+    unsigned int rate, unsigned int channels, unsigned int bits)
+{
+#ifdef USE_ALSA
+    snd_pcm_format_t format;
+    snd_pcm_sframes_t written;
+    unsigned long frame_size;
+    unsigned long count;
+    int err;
+
+    track_frames = 0;
+    played_frames = 0;
+
+    if ((channels == 0) || ((bits != 8) && (bits != 16)))
+    {
+        return false;
+    }
+    if (!tux_sound_player_open())
+    {
+        return false;
+    }
+
+    format = (bits == 16) ? SND_PCM_FORMAT_S16_LE : SND_PCM_FORMAT_U8;
+    err = snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+        channels, rate, 1, SOUND_PLAYER_LATENCY);
+    if (err < 0)
+    {
+        log_error("Can't set the parameters of %s (%s)", SOUND_PLAYER_DEVICE,
+            snd_strerror(err));
+        return false;
+    }
+
+    frame_size = channels * (bits / 8);
+    track_frames = size / frame_size;
+    while (played_frames < track_frames)
+    {
+        count = track_frames - played_frames;
+        if (count > SOUND_PLAYER_CHUNK)
+        {
+            count = SOUND_PLAYER_CHUNK;
+        }
+        written = snd_pcm_writei(pcm, samples + played_frames * frame_size,
+            count);
+        if (written == -EAGAIN)
+        {
+            continue;
+        }
+        if (written < 0)
+        {
+            /* Underrun or suspend */
+            err = snd_pcm_recover(pcm, (int)written, 1);
+            if (err < 0)
+            {
+                log_error("Playback on %s failed (%s)", SOUND_PLAYER_DEVICE,
+                    snd_strerror(err));
+                return false;
+            }
+            continue;
+        }
+        played_frames += written;
+    }
+
+    snd_pcm_drain(pcm);
+
+    return true;
+#else
+    (void)samples;
+    (void)size;
+    (void)rate;
+    (void)channels;
+    (void)bits;
+    return false;
+#endif
+}
+
+/**
+ * \brief Get the progress of the current track.
+ * \return The part of the track written to the device, in percent.
+ */
+LIBLOCAL int
+tux_sound_player_get_progress(void)
+{
+    unsigned long total = track_frames;
+    unsigned long played = played_frames;
+
+    if (total == 0)
+    {
+        return 0;
+    }
+    if (played >= total)
+    {
+        return 100;
+    }
+
+    return (int)((played * 100) / total);
+}
+
+/**
+ * \brief Close the Tux audio device.
+ */
+LIBLOCAL void
+tux_sound_player_close(void)
+{
+#ifdef USE_ALSA
+    if (pcm == NULL)
+    {
+        return;
+    }
+
+    snd_pcm_close(pcm);
+    pcm = NULL;
+#endif
+    track_frames = 0;
+    played_frames = 0;
+}
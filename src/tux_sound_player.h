@@ -0,0 +1,45 @@
+/*
+ * Tux Droid - Sound player
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_sound_player.h
+ * \brief ALSA playback of the sound reflash tracks header.
+ */
+
+#ifndef _TUX_SOUND_PLAYER_H_
+#define _TUX_SOUND_PLAYER_H_
+
+#include <stdbool.h>
+
+/** \brief ALSA device of the Tux audio */
+#define SOUND_PLAYER_DEVICE             "plughw:TuxDroid"
+/** \brief Frames written to the device at once */
+#define SOUND_PLAYER_CHUNK              1024
+/** \brief Latency of the device (microseconds) */
+#define SOUND_PLAYER_LATENCY            500000
+
+extern bool tux_sound_player_open(void);
+extern bool tux_sound_player_play(const unsigned char *samples,
+    unsigned long size, unsigned int rate, unsigned int channels,
+    unsigned int bits);
+extern int tux_sound_player_get_progress(void);
+extern void tux_sound_player_close(void);
+
+#endif /* _TUX_SOUND_PLAYER_H_ */
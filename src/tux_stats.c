@@ -0,0 +1,203 @@
+/*
+ * Tux Droid - Link and frame statistics
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_stats.c
+ * \brief Link and frame statistics functions.
+ *
+ * The counters are monotonic, they are never reset while the library is
+ * loaded. The frames are counted by the read loop and added once per read
+ * cycle; the rates are the increments over the last STATS_RATE_PERIOD.
+ */
+
+#include <string.h>
+
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
+
+#include "log.h"
+#include "tux_hw_status.h"
+#include "tux_misc.h"
+#include "tux_stats.h"
+
+/** \brief Current statistics */
+static tux_stats_t stats;
+/** \brief Start of the counting */
+static double start_time = 0.0;
+/** \brief Start of the current rate period */
+static double period_start = 0.0;
+/** \brief Counters at the start of the rate period */
+static uint64_t period_frames[STATS_FRAME_TYPES];
+static uint64_t period_counters[STATS_COUNTER_NUMBER];
+/** \brief Flag which indicates if the module is initialized */
+static bool stats_ready = false;
+
+#ifdef USE_MUTEX
+static mutex_t __stats_mutex;
+#endif
+
+/**
+ * \brief Initialize the statistics.
+ * Only the first call has an effect, so the counters survive the
+ * reconnections of the dongle.
+ */
+LIBLOCAL void
+tux_stats_init(void)
+{
+    if (stats_ready)
+    {
+        return;
+    }
+
+#ifdef USE_MUTEX
+    mutex_init(__stats_mutex);
+#endif
+    memset(&stats, 0, sizeof(stats));
+    memset(period_frames, 0, sizeof(period_frames));
+    memset(period_counters, 0, sizeof(period_counters));
+    start_time = get_time();
+    period_start = start_time;
+    stats_ready = true;
+}
+
+/**
+ * \brief Increment a link counter.
+ * \param counter Counter to increment.
+ */
+LIBLOCAL void
+tux_stats_count(stats_counter_t counter)
+{
+    if (!stats_ready)
+    {
+        return;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__stats_mutex);
+#endif
+    stats.counters[counter]++;
+#ifdef USE_MUTEX
+    mutex_unlock(__stats_mutex);
+#endif
+}
+
+/**
+ * \brief Get the value of a link counter.
+ * \param counter Counter to read.
+ * \return The value of the counter.
+ */
+LIBLOCAL uint64_t
+tux_stats_get_counter(stats_counter_t counter)
+{
+    uint64_t value;
+
+    if (!stats_ready)
+    {
+        return 0;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__stats_mutex);
+#endif
+    value = stats.counters[counter];
+#ifdef USE_MUTEX
+    mutex_unlock(__stats_mutex);
+#endif
+
+    return value;
+}
+
+/**
+ * \brief Add the frames of a read cycle and update the rates.
+ * \param frame_counts Frames received during the cycle, by header.
+ */
+LIBLOCAL void
+tux_stats_end_cycle(const unsigned int *frame_counts)
+{
+    double now;
+    double elapsed;
+    int i;
+
+    if (!stats_ready)
+    {
+        return;
+    }
+
+    now = get_time();
+
+#ifdef USE_MUTEX
+    mutex_lock(__stats_mutex);
+#endif
+    for (i = 0; i < STATS_FRAME_TYPES; i++)
+    {
+        stats.frames[i] += frame_counts[i];
+    }
+    /* The logger counts its drops itself */
+    stats.counters[STATS_LOG_DROPPED] = log_get_dropped();
+
+    elapsed = now - period_start;
+    if (elapsed >= STATS_RATE_PERIOD)
+    {
+        for (i = 0; i < STATS_FRAME_TYPES; i++)
+        {
+            stats.frame_rates[i] = (stats.frames[i] - period_frames[i])
+                / elapsed;
+            period_frames[i] = stats.frames[i];
+        }
+        for (i = 0; i < STATS_COUNTER_NUMBER; i++)
+        {
+            stats.rates[i] = (stats.counters[i] - period_counters[i])
+                / elapsed;
+            period_counters[i] = stats.counters[i];
+        }
+        period_start = now;
+    }
+#ifdef USE_MUTEX
+    mutex_unlock(__stats_mutex);
+#endif
+}
+
+/**
+ * \brief Get a copy of the statistics.
+ * \param copy Output copy.
+ */
+LIBLOCAL void
+tux_stats_get(tux_stats_t *copy)
+{
+    if (!stats_ready)
+    {
+        memset(copy, 0, sizeof(tux_stats_t));
+        return;
+    }
+
+#ifdef USE_MUTEX
+    mutex_lock(__stats_mutex);
+#endif
+    *copy = stats;
+#ifdef USE_MUTEX
+    mutex_unlock(__stats_mutex);
+#endif
+    copy->counters[STATS_LOG_DROPPED] = log_get_dropped();
+    copy->uptime = get_time() - start_time;
+    copy->pongs_pending = hw_status_table.pong.pongs_pending_number;
+    copy->pongs_lost_by_i2c = hw_status_table.pong.pongs_lost_by_i2c_number;
+    copy->pongs_lost_by_rf = hw_status_table.pong.pongs_lost_by_rf_number;
+}
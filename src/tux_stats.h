@@ -0,0 +1,77 @@
+/*
+ * Tux Droid - Link and frame statistics
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_stats.h
+ * \brief Link and frame statistics header.
+ */
+
+#ifndef _TUX_STATS_H_
+#define _TUX_STATS_H_
+
+#include <stdint.h>
+
+/** \brief Number of status frame types (headers_id_t) */
+#define STATS_FRAME_TYPES               16
+/** \brief Period of the computation of the rates (seconds) */
+#define STATS_RATE_PERIOD               1.0
+
+/**
+ * \brief Counters of the link.
+ */
+typedef enum {
+    STATS_USB_READS = 0,        /**< Status requests read from the dongle */
+    STATS_USB_READ_FAILURES,    /**< Failed status requests */
+    STATS_USB_WRITES,           /**< Frames written to the dongle */
+    STATS_USB_WRITE_FAILURES,   /**< Failed writes */
+    STATS_EMPTY_FRAMES,         /**< Reads without status while RF is on */
+    STATS_FROZEN_FRAMES,        /**< Reads repeating the last USB frame */
+    STATS_UNKNOWN_FRAMES,       /**< Status frames with an unknown header */
+    STATS_RF_TRANSITIONS,       /**< Changes of the RF state */
+    STATS_DONGLE_DISCONNECTIONS,/**< Dongle lost on a read or a write */
+    STATS_DONGLE_RECONNECTIONS, /**< Dongle captured again */
+    STATS_COMMANDS_DROPPED,     /**< Commands dropped or refused by the
+                                     command stacks */
+    STATS_LOG_DROPPED,          /**< Log messages lost by the logger */
+    STATS_COUNTER_NUMBER,
+} stats_counter_t;
+
+/**
+ * \brief Statistics of the driver.
+ */
+typedef struct {
+    double      uptime; /**< Time since the start of the counting */
+    uint64_t    frames[STATS_FRAME_TYPES]; /**< Frames by header */
+    double      frame_rates[STATS_FRAME_TYPES]; /**< Frames by header per
+                                                     second */
+    uint64_t    counters[STATS_COUNTER_NUMBER]; /**< Link counters */
+    double      rates[STATS_COUNTER_NUMBER]; /**< Link counters per second */
+    unsigned int pongs_pending; /**< Pongs pending in the last pong frame */
+    unsigned int pongs_lost_by_i2c; /**< Pongs lost by the I2C */
+    unsigned int pongs_lost_by_rf; /**< Pongs lost by the RF */
+} tux_stats_t;
+
+extern void tux_stats_init(void);
+extern void tux_stats_count(stats_counter_t counter);
+extern uint64_t tux_stats_get_counter(stats_counter_t counter);
+extern void tux_stats_end_cycle(const unsigned int *frame_counts);
+extern void tux_stats_get(tux_stats_t *stats);
+
+#endif /* _TUX_STATS_H_ */
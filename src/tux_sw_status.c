@@ -20,13 +20,15 @@
 
 /*
 This file contains the eventing code for the tux
-values stored are the last evented values (so not the current values)
-there is no external function that allows retrieving that value so it
-was decided not to store the current value as there was no need for it
+the status table holds the current values, the event filters hold the
+last evented values. A change held back by the minimal interval of its
+filter is evented at the end of a read cycle once the interval has passed,
+so the last value of a status is never lost
 */
 
 #include <assert.h>
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -38,6 +40,7 @@ was decided not to store the current value as there was no need for it
 #include "tux_hw_status.h"
 #include "tux_misc.h"
 #include "tux_sw_status.h"
+#include "tux_tracer.h"
 #include "version.h"
 
 /*
@@ -67,6 +70,95 @@ typedef struct
 static mutex_t __status_mutex;
 #endif
 static event_callback_t event_funct;
+static event_ex_callback_t event_ex_funct;
+/** Statuses delivered to the callbacks */
+static uint64_t subscription_mask = STATUS_MASK_ALL;
+/** Statuses delivered to the string callback */
+static uint64_t event_mask = STATUS_MASK_ALL;
+/** Statuses delivered to the binary callback */
+static uint64_t event_ex_mask = STATUS_MASK_ALL;
+static event_batch_callback_t event_batch_funct;
+/** Statuses delivered to the batch callback */
+static uint64_t event_batch_mask = STATUS_MASK_ALL;
+/** Events gathered since the last batch, protected by the status mutex */
+static status_event_t event_batch[STATUS_BATCH_SIZE];
+static int event_batch_count = 0;
+/** Sequence number of the last event */
+static unsigned int event_seq = 0;
+/** Sequence counter of the status table, odd while it is modified */
+static volatile unsigned int status_seq = 0;
+
+/** Number of status changes which can wait for their delivery */
+#define PENDING_EVENTS_SIZE 256
+
+/** Status change waiting for its delivery to the callbacks */
+typedef struct {
+    sw_status_t status; /**< Copy of the status after the change */
+    double delay; /**< Time since the previous update */
+    double timestamp; /**< Monotonic time of the change */
+    unsigned int seq; /**< Sequence number of the event */
+    bool end_of_cycle; /**< Not an event : delivery point of the batch */
+} pending_event_t;
+
+/** Pending events, protected by the status mutex */
+static pending_event_t pending_events[PENDING_EVENTS_SIZE];
+static unsigned int pending_head = 0;
+static unsigned int pending_count = 0;
+/** A thread is delivering the pending events */
+static bool draining_events = false;
+static status_dispatch_mode_t dispatch_mode = STATUS_DISPATCH_SYNC;
+static status_overflow_policy_t overflow_policy = STATUS_OVERFLOW_DROP_OLDEST;
+static status_dispatch_stats_t dispatch_stats;
+#ifdef USE_MUTEX
+/** Signaled when an event is queued or the dispatch thread must stop */
+static cond_t __events_cond;
+/** Signaled when an event leaves the queue */
+static cond_t __room_cond;
+static thread_t dispatch_thread;
+static bool dispatch_thread_running = false;
+/** The mutex and the condition variables are initialized */
+static bool sync_ready = false;
+
+static void start_dispatch_thread(void);
+/** The current thread runs the callbacks, it must never wait for room */
+static thread_local_t bool in_dispatch = false;
+#endif
+
+/** Last values of a status, oldest first from head */
+typedef struct {
+    unsigned int head; /**< Index of the oldest sample */
+    unsigned int count; /**< Number of valid samples */
+    status_sample_t samples[STATUS_HISTORY_SIZE]; /**< Sample ring */
+} status_history_t;
+
+/** Histories of the statuses, protected by the status mutex */
+static status_history_t status_history[SW_STATUS_NUMBER];
+/** Statuses which record their history */
+static uint64_t history_mask = 0;
+
+/** Slots of the name index, a power of 2 above twice the statuses */
+#define NAME_INDEX_SIZE 128
+
+/** Open addressing hash table of the names, -1 for a free slot */
+static signed char name_index[NAME_INDEX_SIZE];
+static volatile bool name_index_built = false;
+
+/** Event filter of a status */
+typedef struct {
+    float threshold; /**< Minimal change, in the unit of the status */
+    float hysteresis; /**< Additional change to go back */
+    double min_interval; /**< Minimal time between two events */
+    double last_event_time; /**< Time of the last event */
+    float last_value; /**< Value of the last event, numeric statuses */
+    const char *last_str; /**< Value of the last event, string statuses */
+    int last_direction; /**< Direction of the last change, 0 before */
+} status_filter_t;
+
+/** Event filters, protected by the status mutex */
+static status_filter_t status_filters[SW_STATUS_NUMBER];
+static bool status_filters_ready = false;
+/** Statuses with a change held back by the minimal interval */
+static uint64_t held_mask = 0;
 
 #define INIT_FLOATID(id, value_fmt, name, value_doc, initval, threshold) \
     { id, name, value_fmt, {.floatvalue = initval}, threshold, value_doc, 0.0 },
@@ -127,7 +219,7 @@ sw_status_t sw_status_table[SW_STATUS_NUMBER] = {
         STRING_VALUE_UNPLUGGED, 1)
 
     INIT_INTID(SW_ID_BATTERY_LEVEL, ID_FMT_INT,
-        "battery_level", "range[4000..6500] (mV)", 0, 1)
+        "battery_level", "range[4000..6500] (mV)", 0, 100)
 
     INIT_STRINGID(SW_ID_BATTERY_STATE, ID_FMT_STRING,
         "battery_state", "EMPTY|LOW|HIGH|FULL", STRING_VALUE_EMPTY, 1)
@@ -207,8 +299,274 @@ sw_status_t sw_status_table[SW_STATUS_NUMBER] = {
 
     INIT_INTID(SW_ID_FLASH_SOUND_COUNT, ID_FMT_UINT8,
         "sound_flash_count", "range[0..255]", 0, 1)
+
+    INIT_INTID(SW_ID_SOUND_REFLASH_TRACK_PROGRESS, ID_FMT_UINT8,
+        "sound_reflash_track_progress", "range[0..100]", 0, 1)
 };
 
+#ifdef USE_MUTEX
+/**
+ *  Initialize the mutex and the condition variables, once : the dispatch
+ *  thread or a blocked update may wait on them when the driver restarts.
+ */
+static void
+init_sync(void)
+{
+    if (sync_ready)
+    {
+        return;
+    }
+
+    mutex_init(__status_mutex);
+    cond_init(__events_cond);
+    cond_init(__room_cond);
+    sync_ready = true;
+}
+
+/**
+ *  Check if a thread will take the queued events out of the queue.
+ *  Must be called with the status mutex locked.
+ */
+static bool
+queue_has_reader(void)
+{
+    return (dispatch_mode == STATUS_DISPATCH_POLL) ||
+           ((dispatch_mode == STATUS_DISPATCH_THREAD) &&
+            dispatch_thread_running);
+}
+
+/**
+ *  Wait until the event queue has room, with the blocking overflow policy.
+ *  The thread which runs the callbacks never waits.
+ *  Must be called with the status mutex locked.
+ */
+static void
+wait_for_room(void)
+{
+    if ((overflow_policy == STATUS_OVERFLOW_BLOCK) &&
+        queue_has_reader() && !in_dispatch &&
+        (pending_count == PENDING_EVENTS_SIZE))
+    {
+        dispatch_stats.blocked++;
+        while ((overflow_policy == STATUS_OVERFLOW_BLOCK) &&
+               queue_has_reader() &&
+               (pending_count == PENDING_EVENTS_SIZE))
+        {
+            cond_wait(__room_cond, __status_mutex);
+        }
+    }
+}
+#endif
+
+/**
+ *  Set the default event filters from the status table, once : the filters
+ *  set by the application before the start of the driver are kept.
+ *  The thresholds of the float statuses are scaled by 1000 in the table.
+ */
+static void
+init_filters(void)
+{
+    status_filter_t *filter;
+    int i;
+
+    if (status_filters_ready)
+    {
+        return;
+    }
+
+    for (i = 0; i < SW_STATUS_NUMBER; i++)
+    {
+        filter = &status_filters[i];
+        memset(filter, 0, sizeof(status_filter_t));
+        /* No interval to respect before the first event */
+        filter->last_event_time = -HUGE_VAL;
+        switch (sw_status_table[i].value_fmt) {
+        case ID_FMT_FLOAT:
+            filter->threshold = sw_status_table[i].event_threshold / 1000.0;
+            filter->last_value = sw_status_table[i].floatvalue;
+            break;
+        case ID_FMT_STRING:
+            filter->threshold = sw_status_table[i].event_threshold;
+            filter->last_str = sw_status_table[i].strvalue;
+            break;
+        default:
+            filter->threshold = sw_status_table[i].event_threshold;
+            filter->last_value = sw_status_table[i].intvalue;
+            break;
+        }
+    }
+    status_filters_ready = true;
+}
+
+/**
+ *  FNV-1a hash of a status name.
+ */
+static unsigned int
+hash_name(const char *name, size_t len)
+{
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ *  Build the name index from the status table, once : the names never
+ *  change, and the lookups read the index without lock.
+ */
+static void
+build_name_index(void)
+{
+    unsigned int slot;
+    int i;
+
+    if (name_index_built)
+    {
+        return;
+    }
+
+    for (slot = 0; slot < NAME_INDEX_SIZE; slot++)
+    {
+        name_index[slot] = -1;
+    }
+    for (i = 0; i < SW_STATUS_NUMBER; i++)
+    {
+        slot = hash_name(sw_status_table[i].name,
+                         strlen(sw_status_table[i].name)) &
+               (NAME_INDEX_SIZE - 1);
+        while (name_index[slot] >= 0)
+        {
+            slot = (slot + 1) & (NAME_INDEX_SIZE - 1);
+        }
+        name_index[slot] = i;
+    }
+    __sync_synchronize();
+    name_index_built = true;
+}
+
+/**
+ *  Find a status by its name.
+ *  The names are never written, no need to lock.
+ *  @param name Name, not null terminated.
+ *  @param len Length of the name.
+ *  @param id Output identifier.
+ */
+static TuxDrvError
+find_name(const char *name, size_t len, int *id)
+{
+    unsigned int slot;
+    int i;
+
+    if (!name_index_built)
+    {
+        /* Lookup before the initialization of the module */
+        for (i = 0; i < SW_STATUS_NUMBER; i++)
+        {
+            if (!strncmp(name, sw_status_table[i].name, len) &&
+                (sw_status_table[i].name[len] == '\0'))
+            {
+                *id = i;
+                return E_TUXDRV_NOERROR;
+            }
+        }
+        return E_TUXDRV_INVALIDNAME;
+    }
+
+    slot = hash_name(name, len) & (NAME_INDEX_SIZE - 1);
+    while ((i = name_index[slot]) >= 0)
+    {
+        if (!strncmp(name, sw_status_table[i].name, len) &&
+            (sw_status_table[i].name[len] == '\0'))
+        {
+            *id = i;
+            return E_TUXDRV_NOERROR;
+        }
+        slot = (slot + 1) & (NAME_INDEX_SIZE - 1);
+    }
+
+    return E_TUXDRV_INVALIDNAME;
+}
+
+/**
+ *  Start a modification of the status table.
+ *  The writers are serialized by the mutex, the readers are not locked : the
+ *  sequence counter is odd while the table is modified.
+ */
+static void
+status_write_begin(void)
+{
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+    /* Wait before the modification, the readers are not held */
+    wait_for_room();
+#endif
+    status_seq++;
+    __sync_synchronize();
+}
+
+/**
+ *  End a modification of the status table.
+ */
+static void
+status_write_end(void)
+{
+    __sync_synchronize();
+    status_seq++;
+#ifdef USE_MUTEX
+    mutex_unlock(__status_mutex);
+#endif
+}
+
+/**
+ *  Start a read of the status table.
+ *  @return The sequence counter to check at the end of the read.
+ */
+static unsigned int
+status_read_begin(void)
+{
+    unsigned int seq;
+
+    /* Wait for the end of a modification in progress */
+    while ((seq = status_seq) & 1)
+    {
+    }
+    __sync_synchronize();
+    return seq;
+}
+
+/**
+ *  Check if the status table has been modified during a read.
+ *  @param seq Sequence counter returned by status_read_begin().
+ *  @return True if the read must be done again.
+ */
+static bool
+status_read_retry(unsigned int seq)
+{
+    __sync_synchronize();
+    return seq != status_seq;
+}
+
+/**
+ *  Read a consistent copy of a status without locking.
+ */
+static void
+read_status(int id, sw_status_t *status)
+{
+    unsigned int seq;
+
+    do
+    {
+        seq = status_read_begin();
+        *status = sw_status_table[id];
+    } while (status_read_retry(seq));
+}
+
 /**
  *
  */
@@ -219,8 +577,10 @@ tux_sw_status_init(void)
     int i;
 
 #ifdef USE_MUTEX
-    mutex_init(__status_mutex);
+    init_sync();
 #endif
+    build_name_index();
+    init_filters();
 
     sprintf(driver_symbolic_version, "libtuxdriver_%d.%d.%d-r%d",
         VER_MAJOR,
@@ -237,6 +597,13 @@ tux_sw_status_init(void)
         sw_status_table[i].lu_time = get_time();
     }
 
+#ifdef USE_MUTEX
+    /* The dispatch thread stopped by tux_sw_status_stop runs again */
+    if (dispatch_mode == STATUS_DISPATCH_THREAD)
+    {
+        start_dispatch_thread();
+    }
+#endif
 
 #ifdef GENERATE_DOC
     tux_sw_status_dump_status_doc();
@@ -265,27 +632,20 @@ tux_sw_status_name_from_id(int id, char *name)
 LIBLOCAL TuxDrvError
 tux_sw_status_id_from_name(const char *name, int *id)
 {
-    int i = -1;
+    return find_name(name, strlen(name), id);
+}
 
-#ifdef USE_MUTEX
-    mutex_lock(__status_mutex);
-#endif
-    for (i = 0; i < SW_STATUS_NUMBER; i++)
-    {
-        if (!(strcmp(name, sw_status_table[i].name)))
-        {
-            *id = i;
-#ifdef USE_MUTEX
-            mutex_unlock(__status_mutex);
-#endif
-            return E_TUXDRV_NOERROR;
-        }
-    }
-#ifdef USE_MUTEX
-    mutex_unlock(__status_mutex);
-#endif
+/**
+ *  Get the identifier of the status of a state string, as given to the
+ *  event callback ("name:format:value:delay").
+ */
+LIBLOCAL TuxDrvError
+tux_sw_status_id_from_state(const char *state, int *id)
+{
+    const char *end = strchr(state, ':');
 
-    return E_TUXDRV_INVALIDNAME;
+    return find_name(state, (end != NULL) ? (size_t)(end - state) :
+                     strlen(state), id);
 }
 
 /**
@@ -315,14 +675,11 @@ tux_sw_status_value_fmt_from_id(int id)
  *
  */
 static void
-get_status_value_str(int id, char *str)
+get_status_value_str(const sw_status_t *status, char *str)
 {
-#ifdef USE_MUTEX
-    mutex_lock(__status_mutex);
-#endif
-    switch (sw_status_table[id].value_fmt) {
+    switch (status->value_fmt) {
     case ID_FMT_BOOL:
-        if (sw_status_table[id].intvalue)
+        if (status->intvalue)
         {
             strcpy(str, "True");
         }
@@ -332,57 +689,58 @@ get_status_value_str(int id, char *str)
         }
         break;
     case ID_FMT_UINT8:
-        sprintf(str, "%d", sw_status_table[id].intvalue);
+        sprintf(str, "%d", status->intvalue);
         break;
     case ID_FMT_INT:
-        sprintf(str, "%d", sw_status_table[id].intvalue);
+        sprintf(str, "%d", status->intvalue);
         break;
     case ID_FMT_FLOAT:
-        sprintf(str, "%f", sw_status_table[id].floatvalue);
+        sprintf(str, "%f", status->floatvalue);
         break;
     case ID_FMT_STRING:
-        strcpy(str, sw_status_table[id].strvalue);
+        strcpy(str, status->strvalue);
         break;
     default:
         break;
     }
-#ifdef USE_MUTEX
-    mutex_unlock(__status_mutex);
-#endif
 
     return;
 }
 
+/**
+ *  Format the state of a status copy.
+ *  @param status Copy of the status.
+ *  @param delay Time since the last update.
+ *  @param state Output state string.
+ */
+static void
+get_status_state_str(const sw_status_t *status, double delay, char *state)
+{
+    char value_str[128] = "";
+
+    get_status_value_str(status, value_str);
+    sprintf(state, "%s:%s:%s:%.3f",
+                status->name,
+                tux_sw_status_value_fmt_from_id(status->value_fmt),
+                value_str,
+                delay);
+}
+
 /**
  *
  */
 LIBLOCAL TuxDrvError
 tux_sw_status_get_state_str(int id, char *state)
 {
-    const char *fmt_str;
-    char name_str[128] = "";
-    char value_str[128] = "";
-    TuxDrvError err;
+    sw_status_t status;
 
-#ifdef USE_MUTEX
-    mutex_lock(__status_mutex);
-#endif
-    fmt_str = tux_sw_status_value_fmt_from_id(sw_status_table[id].value_fmt);
-#ifdef USE_MUTEX
-    mutex_unlock(__status_mutex);
-#endif
-    err = tux_sw_status_name_from_id(id, name_str);
-    if (err != E_TUXDRV_NOERROR)
+    if ((id < 0) || (id >= SW_STATUS_NUMBER))
     {
-        return err;
+        return E_TUXDRV_INVALIDIDENTIFIER;
     }
 
-    get_status_value_str(id, value_str);
-    sprintf(state, "%s:%s:%s:%.3f",
-                sw_status_table[id].name,
-                fmt_str,
-                value_str,
-                (get_time() - sw_status_table[id].lu_time));
+    read_status(id, &status);
+    get_status_state_str(&status, get_time() - status.lu_time, state);
 
     return E_TUXDRV_NOERROR;
 }
@@ -393,13 +751,16 @@ tux_sw_status_get_state_str(int id, char *state)
 LIBLOCAL TuxDrvError
 tux_sw_status_get_value_str(int id, char *value)
 {
+    sw_status_t status;
+
     if ((id < 0) || (id >= SW_STATUS_NUMBER))
     {
         strcpy(value, "NULL");
         return E_TUXDRV_INVALIDIDENTIFIER;
     }
 
-    get_status_value_str(id, value);
+    read_status(id, &status);
+    get_status_value_str(&status, value);
 
     return E_TUXDRV_NOERROR;
 }
@@ -424,201 +785,1083 @@ tux_sw_status_get_all_state_str(char *state)
 }
 
 /**
- *
+ *  Check if a callback listens to the events of a status.
  */
-LIBLOCAL void
-tux_sw_status_set_intvalue(int id, int value, bool make_event)
+static bool
+is_subscribed(int id)
 {
-    int delta;
-    char state_str[1024];
+    uint64_t listened = 0;
 
-    if (make_event)
+    if (event_funct)
     {
-#ifdef USE_MUTEX
-        mutex_lock(__status_mutex);
-#endif
+        listened |= event_mask;
+    }
+    if (event_ex_funct)
+    {
+        listened |= event_ex_mask;
+    }
+    if (event_batch_funct)
+    {
+        listened |= event_batch_mask;
+    }
+    return (listened & subscription_mask & STATUS_MASK(id)) != 0;
+}
 
-        delta = sw_status_table[id].intvalue - value;
-        if (delta < 0)
-        {
-            delta = -delta;
-        }
+/**
+ *  Remove the pending event at a position of the queue.
+ *  @param index Position from the head of the queue.
+ */
+static void
+remove_pending(unsigned int index)
+{
+    unsigned int i;
 
-#ifdef USE_MUTEX
-        mutex_unlock(__status_mutex);
-#endif
+    for (i = index; (i + 1) < pending_count; i++)
+    {
+        pending_events[(pending_head + i) % PENDING_EVENTS_SIZE] =
+            pending_events[(pending_head + i + 1) % PENDING_EVENTS_SIZE];
+    }
+    pending_count--;
+}
+
+/**
+ *  Get the next free entry of the pending events.
+ *  A full queue is handled by the overflow policy; when the update could
+ *  not wait for room, the oldest event is dropped.
+ *  Must be called with the status mutex locked.
+ *  @param id Status identifier of the new entry, -1 for a batch point.
+ *  @return The entry to fill.
+ */
+static pending_event_t *
+push_pending(int id)
+{
+    pending_event_t *pending;
+    unsigned int i;
+    bool removed = false;
 
-        if (event_funct)
+    if (pending_count == PENDING_EVENTS_SIZE)
+    {
+        if (overflow_policy == STATUS_OVERFLOW_COALESCE)
         {
-            if (delta >= sw_status_table[id].event_threshold)
+            for (i = 0; i < pending_count; i++)
             {
-#ifdef USE_MUTEX
-                mutex_lock(__status_mutex);
-#endif
-                sw_status_table[id].intvalue = value;
-#ifdef USE_MUTEX
-                mutex_unlock(__status_mutex);
-#endif
-                tux_sw_status_get_state_str(id, state_str);
-                event_funct(state_str);
+                pending = &pending_events[(pending_head + i) %
+                                          PENDING_EVENTS_SIZE];
+                if (!pending->end_of_cycle && (pending->status.id == id))
+                {
+                    remove_pending(i);
+                    dispatch_stats.coalesced++;
+                    removed = true;
+                    break;
+                }
             }
         }
+        if (!removed)
+        {
+            pending_head = (pending_head + 1) % PENDING_EVENTS_SIZE;
+            pending_count--;
+            dispatch_stats.dropped++;
+        }
     }
-    else
+
+    pending = &pending_events[(pending_head + pending_count) %
+                              PENDING_EVENTS_SIZE];
+    pending_count++;
+    if (pending_count > dispatch_stats.max_depth)
     {
-#ifdef USE_MUTEX
-        mutex_lock(__status_mutex);
-#endif
-        sw_status_table[id].intvalue = value;
-#ifdef USE_MUTEX
-        mutex_unlock(__status_mutex);
-#endif
+        dispatch_stats.max_depth = pending_count;
     }
-
 #ifdef USE_MUTEX
-    mutex_lock(__status_mutex);
+    cond_signal(__events_cond);
 #endif
 
-    sw_status_table[id].lu_time = get_time();
-
-#ifdef USE_MUTEX
-    mutex_unlock(__status_mutex);
-#endif
+    return pending;
 }
 
 /**
- *
+ *  Record the change of a status in the pending events.
+ *  Must be called in a write section of the status table.
+ *  @param id Status identifier.
+ *  @param delay Time since the previous update of the status.
  */
-LIBLOCAL void
-tux_sw_status_set_floatvalue(int id, float value, bool make_event)
+static void
+queue_event(int id, double delay)
 {
-    float delta;
-    char state_str[1024];
-
-    if (make_event)
+    pending_event_t *pending;
+
+    pending = push_pending(id);
+    pending->status = sw_status_table[id];
+    pending->delay = delay;
+    pending->timestamp = get_monotonic_time();
+    pending->seq = ++event_seq;
+    pending->end_of_cycle = false;
+    if (tux_trace_enabled)
     {
-#ifdef USE_MUTEX
-        mutex_lock(__status_mutex);
-#endif
+        uint32_t data[2];
 
-        delta = sw_status_table[id].floatvalue - value;
-        if (delta < 0)
+        data[0] = pending->seq;
+        if (pending->status.value_fmt == ID_FMT_FLOAT)
         {
-            delta = -delta;
+            memcpy(&data[1], &pending->status.floatvalue, sizeof(float));
         }
-
-#ifdef USE_MUTEX
-        mutex_unlock(__status_mutex);
-#endif
-
-        if (event_funct)
+        else if (pending->status.value_fmt == ID_FMT_STRING)
         {
-            if ((1000*delta) >= sw_status_table[id].event_threshold)
-            {
+            data[1] = 0;
+        }
+        else
+        {
+            data[1] = (uint32_t)pending->status.intvalue;
+        }
+        tux_trace_add(TUX_TRACE_STATUS_EVENT, id, data, sizeof(data));
+    }
+}
+
+/**
+ *  Deliver the events gathered since the last batch.
+ */
+static void
+deliver_batch(void)
+{
+    status_event_t events[STATUS_BATCH_SIZE];
+    int count;
+
 #ifdef USE_MUTEX
-                mutex_lock(__status_mutex);
+    mutex_lock(__status_mutex);
 #endif
-                sw_status_table[id].floatvalue = value;
+    count = event_batch_count;
+    memcpy(events, event_batch, count * sizeof(status_event_t));
+    event_batch_count = 0;
 #ifdef USE_MUTEX
-                mutex_unlock(__status_mutex);
+    mutex_unlock(__status_mutex);
 #endif
-                tux_sw_status_get_state_str(id, state_str);
-                event_funct(state_str);
+
+    if ((count > 0) && event_batch_funct)
+    {
+        event_batch_funct(events, count);
+    }
+}
+
+/**
+ *  Add an event to the current batch.
+ *  A full batch is delivered before, without waiting for the end of cycle.
+ */
+static void
+add_to_batch(const status_event_t *event)
+{
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+#endif
+    while (event_batch_count == STATUS_BATCH_SIZE)
+    {
+#ifdef USE_MUTEX
+        mutex_unlock(__status_mutex);
+#endif
+        deliver_batch();
+#ifdef USE_MUTEX
+        mutex_lock(__status_mutex);
+#endif
+    }
+    event_batch[event_batch_count++] = *event;
+#ifdef USE_MUTEX
+    mutex_unlock(__status_mutex);
+#endif
+}
+
+/**
+ *  Deliver the event of a status change to the callbacks.
+ *  The binary callback receives the value as is, the string one is an
+ *  adapter which formats the state of the status. The batch callback gets
+ *  it at the end of the read cycle.
+ */
+static void
+dispatch_event(const pending_event_t *pending)
+{
+    status_event_t event;
+    char state_str[1024];
+    int id = pending->status.id;
+
+    event.id = id;
+    event.value_fmt = pending->status.value_fmt;
+    event.intvalue = 0;
+    event.floatvalue = 0.0;
+    event.strvalue = NULL;
+    switch (event.value_fmt) {
+    case ID_FMT_FLOAT:
+        event.floatvalue = pending->status.floatvalue;
+        break;
+    case ID_FMT_STRING:
+        event.strvalue = pending->status.strvalue;
+        break;
+    default:
+        event.intvalue = pending->status.intvalue;
+        break;
+    }
+    event.timestamp = pending->timestamp;
+    event.seq = pending->seq;
+
+    if (event_ex_funct && (event_ex_mask & STATUS_MASK(id)))
+    {
+        event_ex_funct(&event);
+    }
+    if (event_funct && (event_mask & STATUS_MASK(id)))
+    {
+        get_status_state_str(&pending->status, pending->delay, state_str);
+        event_funct(state_str);
+    }
+    if (event_batch_funct && (event_batch_mask & STATUS_MASK(id)))
+    {
+        add_to_batch(&event);
+    }
+}
+
+/**
+ *  Add the current value of a status to its history, when it changed.
+ *  Must be called with the status mutex locked.
+ */
+static void
+record_sample(int id)
+{
+    status_history_t *history = &status_history[id];
+    status_sample_t *last;
+    status_sample_t *sample;
+
+    if (history->count > 0)
+    {
+        last = &history->samples[(history->head + history->count - 1) %
+                                 STATUS_HISTORY_SIZE];
+        switch (sw_status_table[id].value_fmt) {
+        case ID_FMT_FLOAT:
+            if (last->floatvalue == sw_status_table[id].floatvalue)
+            {
+                return;
+            }
+            break;
+        case ID_FMT_STRING:
+            if (last->strvalue == sw_status_table[id].strvalue)
+            {
+                return;
+            }
+            break;
+        default:
+            if (last->intvalue == sw_status_table[id].intvalue)
+            {
+                return;
             }
+            break;
         }
     }
-    else
+
+    if (history->count == STATUS_HISTORY_SIZE)
+    {
+        history->head = (history->head + 1) % STATUS_HISTORY_SIZE;
+        history->count--;
+    }
+    sample = &history->samples[(history->head + history->count) %
+                               STATUS_HISTORY_SIZE];
+    sample->timestamp = get_monotonic_time();
+    sample->intvalue = 0;
+    sample->floatvalue = 0.0;
+    sample->strvalue = NULL;
+    switch (sw_status_table[id].value_fmt) {
+    case ID_FMT_FLOAT:
+        sample->floatvalue = sw_status_table[id].floatvalue;
+        break;
+    case ID_FMT_STRING:
+        sample->strvalue = sw_status_table[id].strvalue;
+        break;
+    default:
+        sample->intvalue = sw_status_table[id].intvalue;
+        break;
+    }
+    history->count++;
+}
+
+/**
+ *  Deliver the pending events outside the lock.
+ *  Only one thread delivers at a time so the events keep their order; a
+ *  status changed from a callback is delivered by the same loop.
+ *  @param max_events Maximal number of events to deliver, 0 for all.
+ *  @return The number of events delivered.
+ */
+static int
+drain_events(int max_events)
+{
+    pending_event_t pending;
+    int count = 0;
+
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+#endif
+    if (draining_events)
     {
 #ifdef USE_MUTEX
+        mutex_unlock(__status_mutex);
+#endif
+        return 0;
+    }
+    draining_events = true;
+
+    while ((pending_count > 0) && ((max_events <= 0) || (count < max_events)))
+    {
+        pending = pending_events[pending_head];
+        pending_head = (pending_head + 1) % PENDING_EVENTS_SIZE;
+        pending_count--;
+#ifdef USE_MUTEX
+        cond_signal(__room_cond);
+        mutex_unlock(__status_mutex);
+        in_dispatch = true;
+#endif
+        if (pending.end_of_cycle)
+        {
+            deliver_batch();
+        }
+        else
+        {
+            dispatch_event(&pending);
+            count++;
+        }
+#ifdef USE_MUTEX
+        in_dispatch = false;
         mutex_lock(__status_mutex);
 #endif
-        sw_status_table[id].floatvalue = value;
+    }
+
+    draining_events = false;
+#ifdef USE_MUTEX
+    if (pending_count > 0)
+    {
+        /* Queued by a callback while the dispatch thread was waiting */
+        cond_signal(__events_cond);
+    }
+    mutex_unlock(__status_mutex);
+#endif
+
+    return count;
+}
+
+/**
+ *  Deliver the events queued by a status update, when the callbacks are
+ *  called by the updating thread.
+ */
+static void
+flush_events(void)
+{
+    if (dispatch_mode == STATUS_DISPATCH_SYNC)
+    {
+        drain_events(0);
+    }
+}
+
 #ifdef USE_MUTEX
+/**
+ *  Loop of the dispatch thread.
+ */
+static callback_t
+dispatch_thread_loop(void *param)
+{
+    mutex_lock(__status_mutex);
+    while (dispatch_thread_running)
+    {
+        if ((pending_count == 0) || draining_events)
+        {
+            cond_wait(__events_cond, __status_mutex);
+            continue;
+        }
         mutex_unlock(__status_mutex);
+        drain_events(0);
+        mutex_lock(__status_mutex);
+    }
+    mutex_unlock(__status_mutex);
+
+    return 0;
+}
+
+/**
+ *  Start the dispatch thread if it is not running.
+ */
+static void
+start_dispatch_thread(void)
+{
+    mutex_lock(__status_mutex);
+    if (dispatch_thread_running)
+    {
+        mutex_unlock(__status_mutex);
+        return;
+    }
+    dispatch_thread_running = true;
+    mutex_unlock(__status_mutex);
+
+    thread_create(dispatch_thread, dispatch_thread_loop, NULL);
+}
+
+/**
+ *  Stop the dispatch thread and wait for its end. The queued events stay
+ *  for the next dispatch.
+ */
+static void
+stop_dispatch_thread(void)
+{
+    mutex_lock(__status_mutex);
+    if (!dispatch_thread_running)
+    {
+        mutex_unlock(__status_mutex);
+        return;
+    }
+    dispatch_thread_running = false;
+    cond_broadcast(__events_cond);
+    /* The blocked updates have no reader anymore */
+    cond_broadcast(__room_cond);
+    mutex_unlock(__status_mutex);
+
+    thread_wait_close(dispatch_thread);
+    thread_delete(dispatch_thread);
+}
 #endif
+
+/**
+ *  Check if the change of a numeric status must make an event, and take it
+ *  as the reference of the next changes when it does.
+ *  Must be called in a write section of the status table.
+ *  @param id Status identifier.
+ *  @param value New value.
+ *  @param now Time of the change.
+ *  @return True if the event passes the filter of the status.
+ */
+static bool
+pass_filter(int id, float value, double now)
+{
+    status_filter_t *filter = &status_filters[id];
+    float delta = value - filter->last_value;
+    float needed = filter->threshold;
+    int direction;
+
+    if (delta == 0.0)
+    {
+        held_mask &= ~STATUS_MASK(id);
+        return false;
+    }
+    direction = (delta > 0.0) ? 1 : -1;
+    if ((filter->last_direction != 0) && (direction != filter->last_direction))
+    {
+        /* Going back needs a larger change */
+        needed += filter->hysteresis;
+    }
+    if (fabsf(delta) < needed)
+    {
+        held_mask &= ~STATUS_MASK(id);
+        return false;
+    }
+    if ((now - filter->last_event_time) < filter->min_interval)
+    {
+        /* Evented by tux_sw_status_flush_event_batch when the interval
+         * has passed */
+        held_mask |= STATUS_MASK(id);
+        return false;
+    }
+
+    held_mask &= ~STATUS_MASK(id);
+    filter->last_value = value;
+    filter->last_direction = direction;
+    filter->last_event_time = now;
+
+    return true;
+}
+
+/**
+ *  Check if the change of a string status must make an event.
+ *  Must be called in a write section of the status table.
+ */
+static bool
+pass_str_filter(int id, const char *value, double now)
+{
+    status_filter_t *filter = &status_filters[id];
+
+    /*
+       the next if statement uses pointer comparison
+       this works like a charm under the following two conditions
+       - value points to a string constants (and not variables)
+       - no duplicate string constants (althought the compiler might
+         pick up this one anyway).
+       If the first condition is not met, we need to copy the string
+       instead of the pointer (and allocate space for it),
+       (or resolve it in the caller, not really a nice solution)
+       If the second condtion is not met something like:
+		      ((filter->last_str == NULL) ||
+		      strcmp(filter->last_str,value)))
+       could be done instead of the value != line)
+    */
+    if ((filter->threshold == 0.0) || (value == filter->last_str))
+    {
+        held_mask &= ~STATUS_MASK(id);
+        return false;
+    }
+    if ((now - filter->last_event_time) < filter->min_interval)
+    {
+        held_mask |= STATUS_MASK(id);
+        return false;
+    }
+
+    held_mask &= ~STATUS_MASK(id);
+    filter->last_str = value;
+    filter->last_event_time = now;
+
+    return true;
+}
+
+/**
+ *  Event the changes held back by the minimal interval of their filter
+ *  whose interval has passed. Called at the end of each read cycle.
+ */
+static void
+flush_held_events(void)
+{
+    double now;
+    bool passed;
+    bool queued = false;
+    int id;
+
+    /* Read without lock, a change held meanwhile waits for the next cycle */
+    if (held_mask == 0)
+    {
+        return;
+    }
+
+    now = get_time();
+    status_write_begin();
+    for (id = 0; id < SW_STATUS_NUMBER; id++)
+    {
+        if (!(held_mask & STATUS_MASK(id)) ||
+            ((now - status_filters[id].last_event_time) <
+             status_filters[id].min_interval))
+        {
+            continue;
+        }
+        if (sw_status_table[id].value_fmt == ID_FMT_STRING)
+        {
+            passed = pass_str_filter(id, sw_status_table[id].strvalue, now);
+        }
+        else if (sw_status_table[id].value_fmt == ID_FMT_FLOAT)
+        {
+            passed = pass_filter(id, sw_status_table[id].floatvalue, now);
+        }
+        else
+        {
+            passed = pass_filter(id, (float)sw_status_table[id].intvalue, now);
+        }
+        if (passed && is_subscribed(id))
+        {
+            queue_event(id, now - sw_status_table[id].lu_time);
+            queued = true;
+        }
+    }
+    status_write_end();
+
+    if (queued)
+    {
+        flush_events();
+    }
+}
+
+/**
+ *  Set the value of a bool, uint8 or int status.
+ *  @param id Status identifier.
+ *  @param value New value.
+ *  @param make_event Make an event if the change passes the filter.
+ *  @return True if the change made an event.
+ */
+LIBLOCAL bool
+tux_sw_status_set_intvalue(int id, int value, bool make_event)
+{
+    double now = get_time();
+    double delay;
+    bool passed = false;
+    bool queued = false;
+
+    status_write_begin();
+
+    delay = now - sw_status_table[id].lu_time;
+    sw_status_table[id].lu_time = now;
+    sw_status_table[id].intvalue = value;
+    if (make_event)
+    {
+        passed = pass_filter(id, (float)value, now);
+        if (passed && is_subscribed(id))
+        {
+            queue_event(id, delay);
+            queued = true;
+        }
+    }
+    if (history_mask & STATUS_MASK(id))
+    {
+        record_sample(id);
+    }
+
+    status_write_end();
+
+    if (queued)
+    {
+        flush_events();
+    }
+
+    return passed;
+}
+
+/**
+ *  Set the value of a float status.
+ *  @param id Status identifier.
+ *  @param value New value.
+ *  @param make_event Make an event if the change passes the filter.
+ *  @return True if the change made an event.
+ */
+LIBLOCAL bool
+tux_sw_status_set_floatvalue(int id, float value, bool make_event)
+{
+    double now = get_time();
+    double delay;
+    bool passed = false;
+    bool queued = false;
+
+    status_write_begin();
+
+    delay = now - sw_status_table[id].lu_time;
+    sw_status_table[id].lu_time = now;
+    sw_status_table[id].floatvalue = value;
+    if (make_event)
+    {
+        passed = pass_filter(id, value, now);
+        if (passed && is_subscribed(id))
+        {
+            queue_event(id, delay);
+            queued = true;
+        }
+    }
+    if (history_mask & STATUS_MASK(id))
+    {
+        record_sample(id);
+    }
+
+    status_write_end();
+
+    if (queued)
+    {
+        flush_events();
+    }
+
+    return passed;
+}
+
+/**
+ *  Set the value of a string status.
+ *  @param id Status identifier.
+ *  @param value New value, a string constant.
+ *  @param make_event Make an event if the value changed.
+ *  @return True if the change made an event.
+ */
+LIBLOCAL bool
+tux_sw_status_set_strvalue(int id, const char *value, bool make_event)
+{
+    double now = get_time();
+    double delay;
+    bool passed = false;
+    bool queued = false;
+
+    status_write_begin();
+
+    delay = now - sw_status_table[id].lu_time;
+    sw_status_table[id].lu_time = now;
+    sw_status_table[id].strvalue = value;
+    if (make_event)
+    {
+        passed = pass_str_filter(id, value, now);
+        if (passed && is_subscribed(id))
+        {
+            queue_event(id, delay);
+            queued = true;
+        }
+    }
+    if (history_mask & STATUS_MASK(id))
+    {
+        record_sample(id);
+    }
+
+    status_write_end();
+
+    if (queued)
+    {
+        flush_events();
+    }
+
+    return passed;
+}
+
+/**
+ *  Set the event filter of a status.
+ *  @param id Status identifier.
+ *  @param threshold Minimal change from the value of the last event, in the
+ *  unit of the status. For a string status, 0 disables the events.
+ *  @param hysteresis Additional change needed when the value goes back in
+ *  the other direction.
+ *  @param min_interval Minimal time between two events (seconds). A change
+ *  held back is reported at the end of the first read cycle after the
+ *  interval, or by an earlier update of the status.
+ *  @return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_sw_status_set_event_filter(int id, float threshold, float hysteresis,
+        float min_interval)
+{
+    if ((id < 0) || (id >= SW_STATUS_NUMBER))
+    {
+        return E_TUXDRV_INVALIDIDENTIFIER;
+    }
+    if ((threshold < 0.0) || (hysteresis < 0.0) || (min_interval < 0.0))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
     }
 
 #ifdef USE_MUTEX
     mutex_lock(__status_mutex);
 #endif
+    init_filters();
+    status_filters[id].threshold = threshold;
+    status_filters[id].hysteresis = hysteresis;
+    status_filters[id].min_interval = min_interval;
+#ifdef USE_MUTEX
+    mutex_unlock(__status_mutex);
+#endif
+
+    return E_TUXDRV_NOERROR;
+}
 
-    sw_status_table[id].lu_time = get_time();
+/**
+ *  Get the event filter of a status.
+ */
+LIBLOCAL TuxDrvError
+tux_sw_status_get_event_filter(int id, float *threshold, float *hysteresis,
+        float *min_interval)
+{
+    if ((id < 0) || (id >= SW_STATUS_NUMBER))
+    {
+        return E_TUXDRV_INVALIDIDENTIFIER;
+    }
 
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+#endif
+    init_filters();
+    *threshold = status_filters[id].threshold;
+    *hysteresis = status_filters[id].hysteresis;
+    *min_interval = (float)status_filters[id].min_interval;
 #ifdef USE_MUTEX
     mutex_unlock(__status_mutex);
 #endif
+
+    return E_TUXDRV_NOERROR;
 }
 
 /**
- *
+ *  Select the statuses which record their history.
+ *  A newly selected status starts its history with its current value.
  */
 LIBLOCAL void
-tux_sw_status_set_strvalue(int id, const char *value, bool make_event)
+tux_sw_status_set_history(uint64_t mask)
 {
-    char state_str[1024];
+    int i;
 
-    if (make_event)
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+#endif
+    for (i = 0; i < SW_STATUS_NUMBER; i++)
     {
-        if (event_funct)
+        if ((mask & STATUS_MASK(i)) && !(history_mask & STATUS_MASK(i)))
         {
-            /*
-               the next if statement uses pointer comparison
-               this works like a charm under the following two conditions
-               - value points to a string constants (and not variables)
-               - no duplicate string constants (althought the compiler might
-                 pick up this one anyway).
-               If the first condition is not met, we need to copy the string
-               instead of the pointer (and allocate space for it),
-               (or resolve it in the caller, not really a nice solution)
-               If the second condtion is not met something like:
-			      ((sw_status_table[id].strvalue == NULL) ||
-			      strcmp(sw_status_table[id].strvalue,value)))
-               could be done instead of the value != line)
-            */
-            if (sw_status_table[id].event_threshold &&
-                 (value != sw_status_table[id].strvalue))
-            {
+            status_history[i].head = 0;
+            status_history[i].count = 0;
+            record_sample(i);
+        }
+    }
+    history_mask = mask;
+#ifdef USE_MUTEX
+    mutex_unlock(__status_mutex);
+#endif
+}
+
+/**
+ *  Read the history of a status.
+ *  @param id Status identifier.
+ *  @param since Only the samples after this monotonic time are returned.
+ *  @param samples Output samples, oldest first.
+ *  @param max_samples Size of samples.
+ *  @return The number of samples written, 0 on invalid parameters.
+ *
+ *  When more samples are available, the oldest ones are returned : the call
+ *  can be repeated with the timestamp of the last sample.
+ */
+LIBLOCAL int
+tux_sw_status_get_history(int id, double since, status_sample_t *samples,
+        int max_samples)
+{
+    status_history_t *history;
+    unsigned int i;
+    int count = 0;
+
+    if ((id < 0) || (id >= SW_STATUS_NUMBER) || (samples == NULL) ||
+        (max_samples <= 0))
+    {
+        return 0;
+    }
+    history = &status_history[id];
+
 #ifdef USE_MUTEX
-                mutex_lock(__status_mutex);
+    mutex_lock(__status_mutex);
 #endif
-		        sw_status_table[id].strvalue = value;
+    for (i = 0; (i < history->count) && (count < max_samples); i++)
+    {
+        status_sample_t *sample = &history->samples[(history->head + i) %
+                                                    STATUS_HISTORY_SIZE];
+        if (sample->timestamp > since)
+        {
+            samples[count++] = *sample;
+        }
+    }
 #ifdef USE_MUTEX
-                mutex_unlock(__status_mutex);
+    mutex_unlock(__status_mutex);
 #endif
-                tux_sw_status_get_state_str(id, state_str);
-                event_funct(state_str);
+
+    return count;
+}
+
+/* A snapshot, like a subscription mask, can't hold more statuses */
+typedef char snapshot_capacity_check[
+    (SW_STATUS_NUMBER <= STATUS_SNAPSHOT_CAPACITY) ? 1 : -1];
+
+/**
+ *  Get a consistent copy of all the statuses without blocking the writers.
+ *  Only the first count values of the snapshot are filled.
+ */
+LIBLOCAL void
+tux_sw_status_get_snapshot(status_snapshot_t *snapshot)
+{
+    unsigned int seq;
+    int i;
+
+    do
+    {
+        seq = status_read_begin();
+        for (i = 0; i < SW_STATUS_NUMBER; i++)
+        {
+            snapshot->values[i].value_fmt = sw_status_table[i].value_fmt;
+            snapshot->values[i].intvalue = 0;
+            snapshot->values[i].floatvalue = 0.0;
+            snapshot->values[i].strvalue = NULL;
+            switch (sw_status_table[i].value_fmt) {
+            case ID_FMT_FLOAT:
+                snapshot->values[i].floatvalue = sw_status_table[i].floatvalue;
+                break;
+            case ID_FMT_STRING:
+                snapshot->values[i].strvalue = sw_status_table[i].strvalue;
+                break;
+            default:
+                snapshot->values[i].intvalue = sw_status_table[i].intvalue;
+                break;
             }
+            snapshot->values[i].lu_time = sw_status_table[i].lu_time;
         }
+    } while (status_read_retry(seq));
+    snapshot->seq = seq;
+    snapshot->count = SW_STATUS_NUMBER;
+}
+
+/**
+ *
+ */
+LIBLOCAL void
+tux_sw_status_set_event_callback(event_callback_t funct)
+{
+    event_funct = funct;
+}
+
+/**
+ *
+ */
+LIBLOCAL void
+tux_sw_status_set_event_ex_callback(event_ex_callback_t funct)
+{
+    event_ex_funct = funct;
+}
+
+/**
+ *  Set the statuses delivered to the callbacks.
+ */
+LIBLOCAL void
+tux_sw_status_set_subscription(uint64_t mask)
+{
+    subscription_mask = mask;
+}
+
+/**
+ *  Set the statuses delivered to the string callback.
+ */
+LIBLOCAL void
+tux_sw_status_set_event_mask(uint64_t mask)
+{
+    event_mask = mask;
+}
+
+/**
+ *  Set the statuses delivered to the binary callback.
+ */
+LIBLOCAL void
+tux_sw_status_set_event_ex_mask(uint64_t mask)
+{
+    event_ex_mask = mask;
+}
+
+/**
+ *  Set the callback which receives the events of a read cycle at once.
+ */
+LIBLOCAL void
+tux_sw_status_set_event_batch_callback(event_batch_callback_t funct)
+{
+    event_batch_funct = funct;
+}
+
+/**
+ *  Set the statuses delivered to the batch callback.
+ */
+LIBLOCAL void
+tux_sw_status_set_event_batch_mask(uint64_t mask)
+{
+    event_batch_mask = mask;
+}
+
+/**
+ *  Deliver the events gathered since the last batch.
+ *  Called at the end of each read cycle. When the callbacks are not called
+ *  by the read loop, the batch is delivered after the events queued before.
+ */
+LIBLOCAL void
+tux_sw_status_flush_event_batch(void)
+{
+    pending_event_t *pending;
+
+    /* The held changes belong to the batch of this cycle */
+    flush_held_events();
+
+    if (dispatch_mode == STATUS_DISPATCH_SYNC)
+    {
+        deliver_batch();
+        return;
     }
-    else
+
+    if (event_batch_funct == NULL)
     {
+        return;
+    }
 #ifdef USE_MUTEX
-        mutex_lock(__status_mutex);
+    mutex_lock(__status_mutex);
+    wait_for_room();
 #endif
-		sw_status_table[id].strvalue = value;
+    pending = push_pending(-1);
+    pending->end_of_cycle = true;
 #ifdef USE_MUTEX
-        mutex_unlock(__status_mutex);
+    mutex_unlock(__status_mutex);
 #endif
+}
+
+/**
+ *  Select the thread which calls the status callbacks.
+ *  Must not be called from a status callback.
+ *  @param mode Dispatch mode (status_dispatch_mode_t).
+ *  @param policy Overflow policy of the event queue
+ *  (status_overflow_policy_t).
+ *  @return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_sw_status_set_dispatch_mode(int mode, int policy)
+{
+    if ((mode < STATUS_DISPATCH_SYNC) || (mode > STATUS_DISPATCH_POLL) ||
+        (policy < STATUS_OVERFLOW_DROP_OLDEST) ||
+        (policy > STATUS_OVERFLOW_BLOCK))
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
+    }
+#ifndef USE_MUTEX
+    /* No thread without the threading layer */
+    if (mode == STATUS_DISPATCH_THREAD)
+    {
+        return E_TUXDRV_INVALIDPARAMETER;
     }
+#endif
 
 #ifdef USE_MUTEX
+    /* The mode can be set before the start of the driver */
+    init_sync();
     mutex_lock(__status_mutex);
 #endif
+    dispatch_mode = mode;
+    overflow_policy = policy;
+#ifdef USE_MUTEX
+    /* The waiting updates may not have to wait anymore */
+    cond_broadcast(__room_cond);
+    mutex_unlock(__status_mutex);
+
+    if (mode == STATUS_DISPATCH_THREAD)
+    {
+        start_dispatch_thread();
+    }
+    else
+    {
+        stop_dispatch_thread();
+    }
+#endif
+
+    if (mode == STATUS_DISPATCH_SYNC)
+    {
+        /* Events left by the previous mode */
+        drain_events(0);
+    }
 
-    sw_status_table[id].lu_time = get_time();
+    return E_TUXDRV_NOERROR;
+}
 
+/**
+ *  Stop the dispatch thread when the driver stops. The dispatch mode is
+ *  kept, tux_sw_status_init starts the thread again.
+ */
+LIBLOCAL void
+tux_sw_status_stop(void)
+{
 #ifdef USE_MUTEX
-    mutex_unlock(__status_mutex);
+    stop_dispatch_thread();
 #endif
 }
 
 /**
- *
+ *  Deliver the queued events in the calling thread, in the poll mode.
+ *  @param max_events Maximal number of events to deliver, 0 for all.
+ *  @return The number of events delivered.
+ */
+LIBLOCAL int
+tux_sw_status_dispatch_events(int max_events)
+{
+    return drain_events(max_events);
+}
+
+/**
+ *  Get the counters of the event queue.
  */
 LIBLOCAL void
-tux_sw_status_set_event_callback(event_callback_t funct)
+tux_sw_status_get_dispatch_stats(status_dispatch_stats_t *stats)
 {
-    event_funct = funct;
+#ifdef USE_MUTEX
+    mutex_lock(__status_mutex);
+#endif
+    *stats = dispatch_stats;
+    stats->depth = pending_count;
+#ifdef USE_MUTEX
+    mutex_unlock(__status_mutex);
+#endif
 }
 
 /**
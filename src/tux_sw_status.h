@@ -22,6 +22,7 @@
 #define _TUX_SW_STATUS_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "tux_error.h"
 
@@ -95,6 +96,7 @@ typedef enum {
     SW_ID_SPIN_LEFT_MOTOR_ON,
     SW_ID_SPIN_RIGHT_MOTOR_ON,
     SW_ID_FLASH_SOUND_COUNT,
+    SW_ID_SOUND_REFLASH_TRACK_PROGRESS,
     SW_STATUS_NUMBER // SW_STATUS_NUMBER must be last and may not be removed !!
 } SW_ID;
 
@@ -107,21 +109,118 @@ typedef enum {
     ID_FMT_STRING,
 } ID_FMT;
 
+/** \brief Bit of a status in a subscription mask */
+#define STATUS_MASK(id)                     (((uint64_t)1) << (id))
+/** \brief Subscription mask of all the statuses */
+#define STATUS_MASK_ALL                     (~((uint64_t)0))
+/** \brief Statuses a snapshot can hold, fixed to keep the size of the
+ * public snapshot when statuses are added */
+#define STATUS_SNAPSHOT_CAPACITY            64
+
 #define STATUS_DOC_FILE_PATH                "./status_doc.txt"
 
 typedef void(*event_callback_t)(char *event);
 
+/** \brief Binary status event */
+typedef struct {
+    int id; /**< Status identifier (SW_ID) */
+    int value_fmt; /**< Type of the value (ID_FMT) */
+    int intvalue; /**< Value of the bool, uint8 and int statuses */
+    float floatvalue; /**< Value of the float statuses */
+    const char *strvalue; /**< Value of the string statuses (static) */
+    double timestamp; /**< Monotonic time of the change (seconds) */
+    unsigned int seq; /**< Sequence number of the event */
+} status_event_t;
+
+typedef void(*event_ex_callback_t)(const status_event_t *event);
+
+/** \brief Thread which calls the status callbacks */
+typedef enum {
+    STATUS_DISPATCH_SYNC = 0, /**< The thread which updates the status */
+    STATUS_DISPATCH_THREAD, /**< A dispatch thread of the driver */
+    STATUS_DISPATCH_POLL, /**< The application, with
+                               tux_sw_status_dispatch_events() */
+} status_dispatch_mode_t;
+
+/** \brief Behaviour of a full event queue */
+typedef enum {
+    STATUS_OVERFLOW_DROP_OLDEST = 0, /**< The oldest event is lost */
+    STATUS_OVERFLOW_COALESCE, /**< The oldest event of the same status is
+                                   removed, else the oldest event */
+    STATUS_OVERFLOW_BLOCK, /**< The status update waits for room */
+} status_overflow_policy_t;
+
+/** \brief Counters of the event queue */
+typedef struct {
+    unsigned int depth; /**< Events waiting for their delivery */
+    unsigned int max_depth; /**< Highest depth reached */
+    unsigned int dropped; /**< Events lost on overflow */
+    unsigned int coalesced; /**< Events replaced by a newer one */
+    unsigned int blocked; /**< Updates which waited for room */
+} status_dispatch_stats_t;
+
+/** \brief Number of samples kept in the history of a status */
+#define STATUS_HISTORY_SIZE                 128
+
+/** \brief Value of a status at a time */
+typedef struct {
+    double timestamp; /**< Monotonic time of the change (seconds) */
+    int intvalue; /**< Value of the bool, uint8 and int statuses */
+    float floatvalue; /**< Value of the float statuses */
+    const char *strvalue; /**< Value of the string statuses (static) */
+} status_sample_t;
+
+/** \brief Maximal number of events delivered in one batch */
+#define STATUS_BATCH_SIZE                   128
+
+typedef void(*event_batch_callback_t)(const status_event_t *events,
+                                      int count);
+
+/** \brief Consistent copy of all the statuses */
+typedef struct {
+    unsigned int seq; /**< Sequence counter of the table at the copy */
+    unsigned int count; /**< Number of valid values (SW_STATUS_NUMBER) */
+    struct {
+        int value_fmt; /**< Type of the value (ID_FMT) */
+        int intvalue; /**< Value of the bool, uint8 and int statuses */
+        float floatvalue; /**< Value of the float statuses */
+        const char *strvalue; /**< Value of the string statuses (static) */
+        double lu_time; /**< Time of the last update */
+    } values[STATUS_SNAPSHOT_CAPACITY]; /**< Statuses indexed by SW_ID */
+} status_snapshot_t;
+
 extern void tux_sw_status_init(void);
-extern void tux_sw_status_set_intvalue(int id, int value, bool make_event);
-extern void tux_sw_status_set_strvalue(int id, const char *value, bool make_event);
-extern void tux_sw_status_set_floatvalue(int id, float value, bool make_event);
+extern void tux_sw_status_stop(void);
+extern bool tux_sw_status_set_intvalue(int id, int value, bool make_event);
+extern bool tux_sw_status_set_strvalue(int id, const char *value, bool make_event);
+extern bool tux_sw_status_set_floatvalue(int id, float value, bool make_event);
+extern TuxDrvError tux_sw_status_set_event_filter(int id, float threshold,
+    float hysteresis, float min_interval);
+extern TuxDrvError tux_sw_status_get_event_filter(int id, float *threshold,
+    float *hysteresis, float *min_interval);
 extern TuxDrvError tux_sw_status_name_from_id(int id, char* name);
 extern TuxDrvError tux_sw_status_id_from_name(const char* name, int *id);
+extern TuxDrvError tux_sw_status_id_from_state(const char *state, int *id);
 extern const char *tux_sw_status_value_fmt_from_id(int id);
 extern TuxDrvError tux_sw_status_get_state_str(int id, char *state);
 extern TuxDrvError tux_sw_status_get_value_str(int id, char *value);
 extern void tux_sw_status_get_all_state_str(char *state);
 extern void tux_sw_status_set_event_callback(event_callback_t funct);
+extern void tux_sw_status_set_event_ex_callback(event_ex_callback_t funct);
+extern void tux_sw_status_set_subscription(uint64_t mask);
+extern void tux_sw_status_set_event_mask(uint64_t mask);
+extern void tux_sw_status_set_event_ex_mask(uint64_t mask);
+extern void tux_sw_status_set_event_batch_callback(
+    event_batch_callback_t funct);
+extern void tux_sw_status_set_event_batch_mask(uint64_t mask);
+extern void tux_sw_status_flush_event_batch(void);
+extern TuxDrvError tux_sw_status_set_dispatch_mode(int mode, int policy);
+extern int tux_sw_status_dispatch_events(int max_events);
+extern void tux_sw_status_get_dispatch_stats(status_dispatch_stats_t *stats);
+extern void tux_sw_status_set_history(uint64_t mask);
+extern int tux_sw_status_get_history(int id, double since,
+    status_sample_t *samples, int max_samples);
+extern void tux_sw_status_get_snapshot(status_snapshot_t *snapshot);
 extern void tux_sw_status_dump_status_doc(void);
 
 #endif /* _TUX_SW_STATUS_H_ */
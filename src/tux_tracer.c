@@ -0,0 +1,488 @@
+/*
+ * Tux Droid - Binary trace recorder
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_tracer.c
+ * \brief Binary trace recorder functions.
+ *
+ * Each thread adds its records to its own buffer, a ring with a single
+ * producer and a single consumer, so recording takes no lock. A collector
+ * thread moves the records of all the buffers to the trace file or to the
+ * memory trace every TRACE_COLLECT_PERIOD. A full buffer loses the new
+ * records, their number is recorded as a TUX_TRACE_LOST record.
+ *
+ * The buffer of a thread is released when the thread exits, and given to a
+ * new thread once the collector has emptied it, so a thread number can be
+ * used by several threads one after the other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#   include <windows.h>
+#else
+#   include <unistd.h>
+#endif
+
+#ifdef USE_MUTEX
+#   include "threading_uniform.h"
+#endif
+
+#include "log.h"
+#include "tux_misc.h"
+#include "tux_tracer.h"
+
+LIBLOCAL volatile bool tux_trace_enabled = false;
+
+#ifdef USE_MUTEX
+/**
+ * \brief State of the buffer of a thread.
+ */
+typedef enum {
+    TRACE_BUFFER_USED,      /**< Owned by a running thread */
+    TRACE_BUFFER_RELEASED,  /**< Its thread has exited */
+    TRACE_BUFFER_FREE,      /**< Emptied, can be taken by a new thread */
+} trace_buffer_state_t;
+
+/**
+ * \brief Buffer of the records of a thread.
+ */
+typedef struct {
+    tux_trace_record_t records[TRACE_BUFFER_SIZE];
+    volatile unsigned int head; /**< Written by the thread */
+    volatile unsigned int tail; /**< Written by the collector */
+    volatile unsigned int lost; /**< Records lost by the thread */
+    unsigned int lost_reported; /**< Lost records already traced */
+    volatile int state;         /**< trace_buffer_state_t */
+} trace_buffer_t;
+
+/** \brief Buffers of the threads, never freed but reused */
+static trace_buffer_t *buffers[TRACE_MAX_THREADS];
+static volatile int buffer_count = 0;
+/** \brief Buffer of the current thread */
+static thread_local_t trace_buffer_t *local_buffer = NULL;
+/** \brief Thread index of the current thread, 0 when not registered */
+static thread_local_t int local_index = 0;
+/** \brief Key releasing the buffer of a thread when it exits */
+static thread_key_t buffer_key;
+/** \brief Flag which indicates if the thread limit was already logged */
+static bool limit_logged = false;
+
+/** \brief Trace file, NULL for the memory trace */
+static FILE *trace_file = NULL;
+/** \brief Memory trace */
+static tux_trace_record_t memory_trace[TRACE_MEMORY_SIZE];
+static unsigned int memory_head = 0;
+static unsigned int memory_count = 0;
+
+static thread_t collector_thread;
+static volatile bool collector_running = false;
+static mutex_t __trace_mutex;
+static bool trace_ready = false;
+
+/**
+ * \brief Release the buffer of a thread which exits.
+ * \param value Buffer of the thread.
+ */
+static thread_key_callback_t
+release_buffer(void *value)
+{
+    trace_buffer_t *buffer = (trace_buffer_t *)value;
+
+    if (buffer != NULL)
+    {
+        __sync_synchronize();
+        buffer->state = TRACE_BUFFER_RELEASED;
+    }
+}
+
+/**
+ * \brief Take a buffer released by an exited thread.
+ * \return The index of the buffer, -1 if none is free.
+ */
+static int
+take_free_buffer(void)
+{
+    int count;
+    int i;
+
+    count = buffer_count;
+    if (count > TRACE_MAX_THREADS)
+    {
+        count = TRACE_MAX_THREADS;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if ((buffers[i] != NULL) &&
+            __sync_bool_compare_and_swap(&buffers[i]->state,
+                TRACE_BUFFER_FREE, TRACE_BUFFER_USED))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * \brief Get the buffer of the current thread, taking or creating it if
+ * needed.
+ * \return The buffer, NULL if too many threads are traced.
+ */
+static trace_buffer_t *
+get_local_buffer(void)
+{
+    trace_buffer_t *buffer;
+    int index;
+
+    if (local_buffer != NULL)
+    {
+        return local_buffer;
+    }
+    if (local_index < 0)
+    {
+        return NULL;
+    }
+
+    index = take_free_buffer();
+    if (index >= 0)
+    {
+        buffer = buffers[index];
+    }
+    else
+    {
+        index = __sync_fetch_and_add(&buffer_count, 1);
+        if (index >= TRACE_MAX_THREADS)
+        {
+            if (!limit_logged)
+            {
+                limit_logged = true;
+                log_warning("More than %d threads traced, the records of "
+                    "the new threads are lost", TRACE_MAX_THREADS);
+            }
+            local_index = -1;
+            return NULL;
+        }
+        buffer = (trace_buffer_t *)calloc(1, sizeof(trace_buffer_t));
+        if (buffer == NULL)
+        {
+            local_index = -1;
+            return NULL;
+        }
+        buffer->state = TRACE_BUFFER_USED;
+        __sync_synchronize();
+        buffers[index] = buffer;
+    }
+    local_index = index + 1;
+    local_buffer = buffer;
+    thread_key_set(buffer_key, buffer);
+
+    return buffer;
+}
+
+/**
+ * \brief Store a record in the output of the trace.
+ * Called by the collector with the trace mutex locked.
+ * \param record Record to store.
+ */
+static void
+output_record(const tux_trace_record_t *record)
+{
+    if (trace_file != NULL)
+    {
+        fwrite(record, sizeof(tux_trace_record_t), 1, trace_file);
+        return;
+    }
+
+    memory_trace[memory_head] = *record;
+    memory_head = (memory_head + 1) % TRACE_MEMORY_SIZE;
+    if (memory_count < TRACE_MEMORY_SIZE)
+    {
+        memory_count++;
+    }
+}
+
+/**
+ * \brief Move the records of all the buffers to the output.
+ */
+static void
+collect_buffers(void)
+{
+    tux_trace_record_t lost_record;
+    trace_buffer_t *buffer;
+    unsigned int lost;
+    int count;
+    int i;
+
+    count = buffer_count;
+    if (count > TRACE_MAX_THREADS)
+    {
+        count = TRACE_MAX_THREADS;
+    }
+
+    mutex_lock(__trace_mutex);
+    for (i = 0; i < count; i++)
+    {
+        buffer = buffers[i];
+        if (buffer == NULL)
+        {
+            continue;
+        }
+        while (buffer->tail != buffer->head)
+        {
+            __sync_synchronize();
+            output_record(&buffer->records[buffer->tail % TRACE_BUFFER_SIZE]);
+            __sync_synchronize();
+            buffer->tail++;
+        }
+        lost = buffer->lost;
+        if (lost != buffer->lost_reported)
+        {
+            memset(&lost_record, 0, sizeof(lost_record));
+            lost_record.timestamp = get_monotonic_time();
+            lost_record.type = TUX_TRACE_LOST;
+            lost_record.thread = i + 1;
+            lost_record.arg = lost - buffer->lost_reported;
+            output_record(&lost_record);
+            buffer->lost_reported = lost;
+        }
+        /* The thread has exited, so the buffer stays empty */
+        if (buffer->state == TRACE_BUFFER_RELEASED)
+        {
+            __sync_synchronize();
+            if (buffer->tail == buffer->head)
+            {
+                buffer->state = TRACE_BUFFER_FREE;
+            }
+        }
+    }
+    if (trace_file != NULL)
+    {
+        fflush(trace_file);
+    }
+    mutex_unlock(__trace_mutex);
+}
+
+/**
+ * \brief Loop of the collector thread.
+ */
+static void *
+collector_loop(void *param)
+{
+    (void)param;
+
+    /* The sleep doesn't use the clock of the driver, which can be virtual */
+    while (collector_running)
+    {
+        collect_buffers();
+#ifdef WIN32
+        Sleep(TRACE_COLLECT_PERIOD);
+#else
+        usleep(TRACE_COLLECT_PERIOD * 1000);
+#endif
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * \brief Start the trace.
+ * \param path Path of the trace file, NULL to keep the trace in memory.
+ * \return The error result.
+ */
+LIBLOCAL TuxDrvError
+tux_trace_start(const char *path)
+{
+#ifdef USE_MUTEX
+    tux_trace_header_t header;
+    int i;
+
+    if (!trace_ready)
+    {
+        mutex_init(__trace_mutex);
+        thread_key_create(buffer_key, release_buffer);
+        trace_ready = true;
+    }
+    if (collector_running)
+    {
+        return E_TUXDRV_BUSY;
+    }
+
+    mutex_lock(__trace_mutex);
+    /* Forget the records added while the previous trace was stopping */
+    for (i = 0; (i < buffer_count) && (i < TRACE_MAX_THREADS); i++)
+    {
+        if (buffers[i] != NULL)
+        {
+            buffers[i]->tail = buffers[i]->head;
+        }
+    }
+    memory_head = 0;
+    memory_count = 0;
+    trace_file = NULL;
+    if (path != NULL)
+    {
+        trace_file = fopen(path, "wb");
+        if (trace_file == NULL)
+        {
+            mutex_unlock(__trace_mutex);
+            log_error("Can't create the trace file %s", path);
+            return E_TUXDRV_FILEERROR;
+        }
+        header.magic = TUX_TRACE_MAGIC;
+        header.version = TUX_TRACE_VERSION;
+        header.record_size = sizeof(tux_trace_record_t);
+        header.start_time = get_monotonic_time();
+        fwrite(&header, sizeof(header), 1, trace_file);
+    }
+    mutex_unlock(__trace_mutex);
+
+    collector_running = true;
+    thread_create(collector_thread, collector_loop, NULL);
+    tux_trace_enabled = true;
+
+    return E_TUXDRV_NOERROR;
+#else
+    (void)path;
+    return E_TUXDRV_FILEERROR;
+#endif
+}
+
+/**
+ * \brief Stop the trace and write the records left.
+ * The memory trace stays readable.
+ */
+LIBLOCAL void
+tux_trace_stop(void)
+{
+#ifdef USE_MUTEX
+    if (!collector_running)
+    {
+        return;
+    }
+
+    tux_trace_enabled = false;
+    collector_running = false;
+    thread_wait_close(collector_thread);
+    thread_delete(collector_thread);
+    collect_buffers();
+
+    mutex_lock(__trace_mutex);
+    if (trace_file != NULL)
+    {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+    mutex_unlock(__trace_mutex);
+#endif
+}
+
+/**
+ * \brief Take the oldest records of the memory trace.
+ * \param records Output records.
+ * \param max Size of the output.
+ * \return The number of records copied.
+ */
+LIBLOCAL int
+tux_trace_read(tux_trace_record_t *records, int max)
+{
+#ifdef USE_MUTEX
+    unsigned int start;
+    int count = 0;
+
+    if (!trace_ready)
+    {
+        return 0;
+    }
+
+    mutex_lock(__trace_mutex);
+    start = (memory_head + TRACE_MEMORY_SIZE - memory_count)
+        % TRACE_MEMORY_SIZE;
+    while ((count < max) && (memory_count > 0))
+    {
+        records[count++] = memory_trace[start];
+        start = (start + 1) % TRACE_MEMORY_SIZE;
+        memory_count--;
+    }
+    mutex_unlock(__trace_mutex);
+
+    return count;
+#else
+    (void)records;
+    (void)max;
+    return 0;
+#endif
+}
+
+/**
+ * \brief Add a record to the buffer of the current thread.
+ * Use the tux_trace macro, which checks first if the trace is running.
+ * \param type Type of the record.
+ * \param arg Main argument.
+ * \param data Payload, up to 8 bytes.
+ * \param size Size of the payload.
+ */
+LIBLOCAL void
+tux_trace_add(tux_trace_type_t type, uint32_t arg, const void *data,
+    int size)
+{
+#ifdef USE_MUTEX
+    trace_buffer_t *buffer;
+    tux_trace_record_t *record;
+    unsigned int head;
+
+    buffer = get_local_buffer();
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    head = buffer->head;
+    if (head - buffer->tail >= TRACE_BUFFER_SIZE)
+    {
+        buffer->lost++;
+        return;
+    }
+
+    record = &buffer->records[head % TRACE_BUFFER_SIZE];
+    record->timestamp = get_monotonic_time();
+    record->type = type;
+    record->thread = local_index;
+    record->arg = arg;
+    memset(record->data, 0, sizeof(record->data));
+    if (data != NULL)
+    {
+        if (size > (int)sizeof(record->data))
+        {
+            size = sizeof(record->data);
+        }
+        memcpy(record->data, data, size);
+    }
+    __sync_synchronize();
+    buffer->head = head + 1;
+#else
+    (void)type;
+    (void)arg;
+    (void)data;
+    (void)size;
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+ * Tux Droid - Binary trace recorder
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_tracer.h
+ * \brief Binary trace recorder header.
+ */
+
+#ifndef _TUX_TRACER_H_
+#define _TUX_TRACER_H_
+
+#include <stdbool.h>
+
+#include "../include/tux_trace.h"
+#include "tux_error.h"
+
+/** \brief Records of the buffer of a thread */
+#define TRACE_BUFFER_SIZE               512
+/** \brief Maximal number of threads traced */
+#define TRACE_MAX_THREADS               64
+/** \brief Records kept by the memory trace */
+#define TRACE_MEMORY_SIZE               65536
+/** \brief Period of the collection of the buffers (milliseconds) */
+#define TRACE_COLLECT_PERIOD            50
+
+/** \brief Flag which indicates if the trace is running, checked before
+ * building a record */
+extern volatile bool tux_trace_enabled;
+
+extern TuxDrvError tux_trace_start(const char *path);
+extern void tux_trace_stop(void);
+extern int tux_trace_read(tux_trace_record_t *records, int max);
+extern void tux_trace_add(tux_trace_type_t type, uint32_t arg,
+    const void *data, int size);
+
+/** \brief Add a record when the trace is running */
+#define tux_trace(type, arg, data, size) \
+    do \
+    { \
+        if (tux_trace_enabled) \
+        { \
+            tux_trace_add((type), (arg), (data), (size)); \
+        } \
+    } while (0)
+
+#endif /* _TUX_TRACER_H_ */
@@ -233,6 +233,7 @@ typedef struct {
         raw_parameters_t                raw_parameters;
     };
     float inserted_at_time;
+    unsigned int submission;
 } delay_cmd_t;
 
 #endif /* _TUX_TYPES_H_ */
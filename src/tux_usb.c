@@ -27,6 +27,8 @@
 #else
 #   include "tux_hid_unix.h"
 #endif
+#include "tux_stats.h"
+#include "tux_tracer.h"
 #include "tux_types.h"
 #include "tux_usb.h"
 
@@ -40,6 +42,7 @@ static simple_callback_t dongle_disconnect_function;
 static simple_callback_t dongle_connect_function;
 static simple_callback_t loop_cycle_complete_function;
 static rf_state_callback_t rf_state_callback_function;
+static write_capture_callback_t write_capture_function = NULL;
 static unsigned char last_knowed_rf_state = 0;
 static char frame_status_request[5] = {1, 1, 0, 0, 0};
 static char frame_reset_dongle[5] = {1, 1, 0, 0, 0xFE};
@@ -65,6 +68,7 @@ static int id_frame_last = 999;
 static int freezed_frame_cnt = 0;
 #endif
 static int empty_frame_cnt = 0;
+static bool captured_once = false;
 
 /**
  *
@@ -231,6 +235,13 @@ tux_usb_capture(void)
     {
         return TuxUSBFuxNotFound;
     }
+    if (captured_once)
+    {
+        tux_stats_count(STATS_DONGLE_RECONNECTIONS);
+    }
+    captured_once = true;
+    tux_trace(TUX_TRACE_RECONNECT,
+        (uint32_t)tux_stats_get_counter(STATS_DONGLE_RECONNECTIONS), NULL, 0);
 
     set_connected(true);
 
@@ -250,6 +261,15 @@ tux_usb_release(void)
     return TuxUSBNoError;
 }
 
+/**
+ *
+ */
+LIBLOCAL void
+tux_usb_set_write_capture(write_capture_callback_t funct)
+{
+    write_capture_function = funct;
+}
+
 /**
  *
  */
@@ -258,8 +278,15 @@ tux_usb_write(const void *buff)
 {
     bool ret;
 
+    if (write_capture_function)
+    {
+        write_capture_function((const unsigned char *)buff);
+        return TuxUSBNoError;
+    }
+
     if (!tux_usb_connected())
     {
+        tux_stats_count(STATS_USB_WRITE_FAILURES);
         log_error("Fux USB device not connected");
         return TuxUSBNotConnected;
     }
@@ -272,14 +299,18 @@ tux_usb_write(const void *buff)
 #ifdef USE_MUTEX
     mutex_unlock(__read_write_mutex);
 #endif
+    tux_trace(TUX_TRACE_USB_WRITE, ret ? 0 : 1, buff, TUX_SEND_LENGTH);
 
     if (!ret)
     {
+        tux_stats_count(STATS_USB_WRITE_FAILURES);
+        tux_stats_count(STATS_DONGLE_DISCONNECTIONS);
         set_connected(false);
         tux_usb_release();
         log_error("Fux is disconnected");
         return TuxUSBDisconnected;
     }
+    tux_stats_count(STATS_USB_WRITES);
     return TuxUSBNoError;
 }
 
@@ -301,12 +332,14 @@ process_usb_frame(const char *data)
     packet_count = data[3];
     data_buf = (char *)data;
     data_buf += 4;
+    tux_trace(TUX_TRACE_USB_READ, packet_count, data, 2);
 
 #ifdef USB_IDFRAME
     /* Check if the frame is newer than the last received one */
     if (id_frame == id_frame_last)
     {
         freezed_frame_cnt++;
+        tux_stats_count(STATS_FROZEN_FRAMES);
         log_warning("The id of USB frame is the same than the previous [%d]",
             freezed_frame_cnt);
 #ifndef USB_DEBUG
@@ -333,6 +366,7 @@ process_usb_frame(const char *data)
     if ((packet_count == 0) && (rf_state == 1))
     {
         empty_frame_cnt++;
+        tux_stats_count(STATS_EMPTY_FRAMES);
 #ifndef USB_DEBUG
         if (empty_frame_cnt > 2)
         {
@@ -358,6 +392,7 @@ process_usb_frame(const char *data)
     if (last_knowed_rf_state != rf_state)
     {
         last_knowed_rf_state = rf_state;
+        tux_stats_count(STATS_RF_TRANSITIONS);
 #ifdef USE_MUTEX
         mutex_lock(__callback_mutex);
 #endif
@@ -422,6 +457,8 @@ tux_usb_read(void *buf)
 #ifdef USE_MUTEX
         mutex_unlock(__read_write_mutex);
 #endif
+        tux_stats_count(STATS_USB_READ_FAILURES);
+        tux_stats_count(STATS_DONGLE_DISCONNECTIONS);
         set_connected(false);
         tux_usb_release();
         log_error("Fux is disconnected");
@@ -430,7 +467,7 @@ tux_usb_read(void *buf)
 
 #ifndef WIN32
     /* Hid read write are not bocking on linux */
-    usleep(10000);
+    wait_seconds(0.01);
 #endif
 
     ret = tux_hid_read(TUX_RECEIVE_LENGTH, (char *)buf);
@@ -440,6 +477,8 @@ tux_usb_read(void *buf)
 
     if (!ret)
     {
+        tux_stats_count(STATS_USB_READ_FAILURES);
+        tux_stats_count(STATS_DONGLE_DISCONNECTIONS);
         set_connected(false);
         tux_usb_reset();
         tux_usb_release();
@@ -447,6 +486,7 @@ tux_usb_read(void *buf)
         return TuxUSBDisconnected;
     }
 
+    tux_stats_count(STATS_USB_READS);
     process_usb_frame((char *)buf);
 
     return TuxUSBNoError;
@@ -520,7 +560,7 @@ read_usb_loop(void)
 
         while (get_time() < current_timeout)
         {
-            usleep(1000);
+            wait_seconds(0.001);
         }
 
         current_timeout = get_time();
@@ -553,7 +593,7 @@ tux_usb_start(void)
     last_knowed_rf_state = 0;
 
     read_usb_loop();
-    usleep(100000);
+    wait_seconds(0.1);
 
     return TuxUSBNoError;
 }
@@ -573,7 +613,7 @@ tux_usb_stop(void)
 
     set_connected(false);
 
-    usleep(500000);
+    wait_seconds(0.5);
 
     ret = tux_usb_release();
     if (ret != TuxUSBNoError)
@@ -613,7 +653,7 @@ tux_usb_send_raw(const unsigned char* data)
 
     ret = tux_usb_write(data);
 
-    usleep(10000);
+    wait_seconds(0.01);
 
     if (ret != TuxUSBNoError)
     {
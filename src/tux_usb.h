@@ -71,6 +71,12 @@ typedef void(*frame_callback_t)(const unsigned char *data);
  */
 typedef void(*rf_state_callback_t)(unsigned char state);
 
+/**
+ *      Callback function prototype for the write capture
+ *      @param data The frame which would have been written
+ */
+typedef void(*write_capture_callback_t)(const unsigned char *data);
+
 /** Initialization of the module
         Some mutex are initialized in this function.
 */
@@ -125,6 +131,14 @@ extern void tux_usb_set_connect_dongle_callback(simple_callback_t funct);
  */
 extern void tux_usb_set_loop_cycle_complete_callback(simple_callback_t funct);
 
+/**
+ *  Set the function which captures the written frames.
+ *  While it is set, the frames are handed to this function instead of being
+ *  written on the dongle.
+ *  @param funct The function will be linked (NULL to stop the capture)
+ */
+extern void tux_usb_set_write_capture(write_capture_callback_t funct);
+
 /**
  *  Write data on usb dongle
  *  @param buff Data to write
@@ -0,0 +1,229 @@
+/*
+ * Tux Droid - Wave files
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_wav.c
+ * \brief Wave files functions.
+ *
+ * A wave file is mapped read-only and its RIFF chunks are walked to find
+ * the format and the samples, whatever the other chunks between them. On
+ * Windows the file is read in memory instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "tux_misc.h"
+#include "tux_wav.h"
+
+/** \brief Size of the RIFF header : "RIFF", size, "WAVE" */
+#define RIFF_HEADER_SIZE                12
+/** \brief Size of a chunk header : identifier, size */
+#define CHUNK_HEADER_SIZE               8
+/** \brief Minimal size of the fmt chunk */
+#define FMT_CHUNK_SIZE                  16
+
+/**
+ * \brief Read a little endian 16 bits value.
+ */
+static unsigned int
+read_le16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ * \brief Read a little endian 32 bits value.
+ */
+static unsigned long
+read_le32(const unsigned char *p)
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+        ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+/**
+ * \brief Map a file read-only.
+ * \param path Path of the file.
+ * \param wav View which receives the mapping.
+ * \return The success.
+ */
+static bool
+map_file(const char *path, tux_wav_t *wav)
+{
+#ifdef WIN32
+    FILE *fp;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(fp);
+        return false;
+    }
+    wav->map = malloc(size);
+    if ((wav->map != NULL) && (fread(wav->map, size, 1, fp) != 1))
+    {
+        free(wav->map);
+        wav->map = NULL;
+    }
+    fclose(fp);
+    wav->map_size = size;
+
+    return wav->map != NULL;
+#else
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size <= 0))
+    {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+    wav->map = map;
+    wav->map_size = st.st_size;
+
+    return true;
+#endif
+}
+
+/**
+ * \brief Open a wave file and find its format and its samples.
+ * A data chunk which claims more bytes than the file holds is cut at the
+ * end of the file.
+ * \param path Path of the file.
+ * \param wav View of the file, to close with tux_wav_close on success.
+ * \return E_TUXDRV_WAVNOTFOUND if the file can't be read,
+ * E_TUXDRV_WAVNOTRIFF if it is not a RIFF WAVE file, E_TUXDRV_WAVNODATA if
+ * the fmt or the data chunk is missing, else E_TUXDRV_NOERROR.
+ */
+LIBLOCAL TuxDrvError
+tux_wav_open(const char *path, tux_wav_t *wav)
+{
+    const unsigned char *file;
+    const unsigned char *fmt = NULL;
+    unsigned long offset;
+    unsigned long chunk_size;
+    unsigned long left;
+
+    memset(wav, 0, sizeof(tux_wav_t));
+    if (!map_file(path, wav))
+    {
+        return E_TUXDRV_WAVNOTFOUND;
+    }
+    file = (const unsigned char *)wav->map;
+
+    if ((wav->map_size < RIFF_HEADER_SIZE) || memcmp(file, "RIFF", 4) ||
+        memcmp(file + 8, "WAVE", 4))
+    {
+        tux_wav_close(wav);
+        return E_TUXDRV_WAVNOTRIFF;
+    }
+
+    offset = RIFF_HEADER_SIZE;
+    while ((offset + CHUNK_HEADER_SIZE) <= wav->map_size)
+    {
+        chunk_size = read_le32(file + offset + 4);
+        left = wav->map_size - offset - CHUNK_HEADER_SIZE;
+
+        if (!memcmp(file + offset, "fmt ", 4))
+        {
+            if ((chunk_size < FMT_CHUNK_SIZE) || (chunk_size > left))
+            {
+                break;
+            }
+            fmt = file + offset + CHUNK_HEADER_SIZE;
+        }
+        else if (!memcmp(file + offset, "data", 4))
+        {
+            wav->samples = file + offset + CHUNK_HEADER_SIZE;
+            wav->size = (chunk_size > left) ? left : chunk_size;
+        }
+        if ((fmt != NULL) && (wav->samples != NULL))
+        {
+            break;
+        }
+        if (chunk_size > left)
+        {
+            break;
+        }
+        /* The chunks are aligned on 2 bytes */
+        offset += CHUNK_HEADER_SIZE + chunk_size + (chunk_size & 1);
+    }
+
+    if ((fmt == NULL) || (wav->samples == NULL))
+    {
+        tux_wav_close(wav);
+        return E_TUXDRV_WAVNODATA;
+    }
+
+    wav->format = read_le16(fmt);
+    wav->channels = read_le16(fmt + 2);
+    wav->rate = read_le32(fmt + 4);
+    wav->bits = read_le16(fmt + 14);
+
+    return E_TUXDRV_NOERROR;
+}
+
+/**
+ * \brief Release the view of a wave file.
+ * Nothing is done if the view is already closed.
+ */
+LIBLOCAL void
+tux_wav_close(tux_wav_t *wav)
+{
+    if (wav->map == NULL)
+    {
+        return;
+    }
+
+#ifdef WIN32
+    free(wav->map);
+#else
+    munmap(wav->map, wav->map_size);
+#endif
+    memset(wav, 0, sizeof(tux_wav_t));
+}
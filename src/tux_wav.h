@@ -0,0 +1,53 @@
+/*
+ * Tux Droid - Wave files
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_wav.h
+ * \brief Wave files header.
+ */
+
+#ifndef _TUX_WAV_H_
+#define _TUX_WAV_H_
+
+#include "tux_error.h"
+
+/** \brief PCM format tag of the fmt chunk */
+#define WAV_FORMAT_PCM                  1
+
+/**
+ * \brief View of a wave file.
+ * The samples point in the mapping of the file, they stay valid until
+ * tux_wav_close.
+ */
+typedef struct {
+    const unsigned char *samples; /**< First sample of the data chunk */
+    unsigned long size; /**< Size of the samples in bytes */
+    unsigned int format; /**< Format tag */
+    unsigned int rate; /**< Sample rate */
+    unsigned int channels; /**< Number of channels */
+    unsigned int bits; /**< Bits per sample */
+    void *map; /**< Mapping of the whole file, NULL when closed */
+    unsigned long map_size; /**< Size of the mapping */
+} tux_wav_t;
+
+extern TuxDrvError tux_wav_open(const char *path, tux_wav_t *wav);
+extern void tux_wav_close(tux_wav_t *wav);
+
+#endif /* _TUX_WAV_H_ */
@@ -0,0 +1,156 @@
+/*
+ * Tux Droid - Status frame decoder benchmark
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Decode status frames without the dongle and print the frames decoded
+ * per second. The frames are read from a recorded traffic file (raw
+ * frames of 4 bytes) or generated like the traffic of an idle Tux Droid
+ * whose light, battery and movements change from time to time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/tux_driver.h"
+
+#define DEFAULT_FRAME_COUNT 10000000
+#define TRAFFIC_MAX_FRAMES 65536
+
+static unsigned char traffic[TRAFFIC_MAX_FRAMES * 4];
+
+/**
+ *
+ */
+static int
+read_traffic(const char *path)
+{
+    FILE *traffic_file;
+    size_t len;
+
+    traffic_file = fopen(path, "rb");
+    if (traffic_file == NULL)
+    {
+        return -1;
+    }
+    len = fread(traffic, 4, TRAFFIC_MAX_FRAMES, traffic_file);
+    fclose(traffic_file);
+
+    return (int)len;
+}
+
+/**
+ *
+ */
+static void
+put_frame(int i, unsigned char header, unsigned char b1, unsigned char b2,
+    unsigned char b3)
+{
+    traffic[i * 4] = header;
+    traffic[i * 4 + 1] = b1;
+    traffic[i * 4 + 2] = b2;
+    traffic[i * 4 + 3] = b3;
+}
+
+/**
+ *
+ */
+static int
+generate_traffic(void)
+{
+    int cycles = TRAFFIC_MAX_FRAMES / 8;
+    int cycle;
+    int i = 0;
+
+    for (cycle = 0; cycle < cycles; cycle++)
+    {
+        /* The eyes blink every 50 cycles */
+        unsigned char moving = (cycle % 50) < 3;
+
+        put_frame(i++, 0xC0, moving ? 0x08 : 0x10, 0x02, 0x40);
+        put_frame(i++, 0xC1, (cycle % 200) < 5 ? 0x08 : 0x00, 0, 0);
+        put_frame(i++, 0xC2, 0x01, (cycle / 10) & 0xFF, 0x00);
+        put_frame(i++, 0xC3, moving ? 3 - (cycle % 50) : 0, 0, 0);
+        put_frame(i++, 0xC4, 0, 0, moving ? 0x04 : 0x00);
+        put_frame(i++, 0xC7, 0x02, 0x80 + ((cycle / 100) & 0x0F), moving);
+        put_frame(i++, 0xCE, 0xFF, 0xFF, 0x00);
+        put_frame(i++, 0xC5, 0x00, 0x00, 0x00);
+    }
+
+    return i;
+}
+
+/**
+ *
+ */
+int
+main(int argc, char *argv[])
+{
+    long frame_count = DEFAULT_FRAME_COUNT;
+    long done = 0;
+    int traffic_frames;
+    double start;
+    double duration;
+
+    if (argc > 3)
+    {
+        fprintf(stderr, "Usage: %s [frame count] [recorded traffic file]\n",
+            argv[0]);
+        return 1;
+    }
+    if (argc >= 2)
+    {
+        frame_count = atol(argv[1]);
+    }
+    if (argc == 3)
+    {
+        traffic_frames = read_traffic(argv[2]);
+        if (traffic_frames <= 0)
+        {
+            fprintf(stderr, "Can't read %s\n", argv[2]);
+            return 1;
+        }
+    }
+    else
+    {
+        traffic_frames = generate_traffic();
+    }
+
+    TuxDrv_SetLogLevel(LOG_LEVEL_NONE);
+    start = get_time();
+    while (done < frame_count)
+    {
+        int count = traffic_frames;
+
+        if (count > frame_count - done)
+        {
+            count = (int)(frame_count - done);
+        }
+        TuxDrv_InjectStatusFrames(traffic, count);
+        done += count;
+    }
+    duration = get_time() - start;
+
+    printf("Frames          : %ld\n", done);
+    printf("Duration        : %.3f s\n", duration);
+    printf("Frames per second: %.0f\n", done / duration);
+
+    return 0;
+}
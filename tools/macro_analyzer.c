@@ -0,0 +1,101 @@
+/*
+ * Tux Droid - Macro analyzer
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/tux_driver.h"
+
+#define MACRO_MAX_SIZE 16384
+#define DEFAULT_MAX_DURATION 600.0
+
+static macro_analysis_t analysis;
+
+/**
+ *
+ */
+static int
+read_macro(const char *path, char *macro, size_t size)
+{
+    FILE *macro_file;
+    size_t len;
+
+    macro_file = fopen(path, "r");
+    if (macro_file == NULL)
+    {
+        return -1;
+    }
+    len = fread(macro, 1, size - 1, macro_file);
+    macro[len] = '\0';
+    fclose(macro_file);
+
+    return 0;
+}
+
+/**
+ *
+ */
+int
+main(int argc, char *argv[])
+{
+    char macro[MACRO_MAX_SIZE];
+    float max_duration = DEFAULT_MAX_DURATION;
+    TuxDrvError err;
+    unsigned int i;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        fprintf(stderr, "Usage: %s <macro file> [max duration (s)]\n",
+            argv[0]);
+        return 1;
+    }
+    if (argc == 3)
+    {
+        max_duration = atof(argv[2]);
+    }
+    if (read_macro(argv[1], macro, sizeof(macro)) < 0)
+    {
+        fprintf(stderr, "Can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    err = TuxDrv_AnalyzeMacro(macro, max_duration, &analysis);
+    if (err != E_TUXDRV_NOERROR)
+    {
+        fprintf(stderr, "Analysis failed: %s\n", TuxDrv_StrError(err));
+        return 1;
+    }
+
+    printf("Duration        : %.2f s%s\n", analysis.duration,
+        analysis.truncated ? " (truncated)" : "");
+    printf("Frames          : %u\n", analysis.frame_count);
+    printf("Peak burst      : %u frames at %.1f s\n", analysis.peak_burst,
+        analysis.peak_burst_time);
+    printf("Cycle overruns  : %u\n", analysis.overrun_count);
+    printf("Lane conflicts  : %u\n", analysis.conflict_count);
+    printf("Frames per second:\n");
+    for (i = 0; i < analysis.seconds; i++)
+    {
+        printf("  %4u s : %u\n", i, analysis.fps[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Tux Droid - Status shared memory dump
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <stdio.h>
+
+#include "../include/tux_status_shm.h"
+
+/* Value formats of the driver (ID_FMT_DRIVER) */
+#define FMT_FLOAT 3
+#define FMT_STRING 4
+
+static tux_status_shm_t status_copy;
+
+/**
+ *
+ */
+int
+main(int argc, char *argv[])
+{
+    tux_status_shm_reader_t *reader;
+    tux_status_shm_entry_t *entry;
+    uint32_t i;
+
+    reader = tux_status_shm_open((argc > 1) ? argv[1] : NULL);
+    if (reader == NULL)
+    {
+        fprintf(stderr, "No status shared memory\n");
+        return 1;
+    }
+    if (tux_status_shm_read(reader, &status_copy) < 0)
+    {
+        fprintf(stderr, "Statuses not published\n");
+        tux_status_shm_close(reader);
+        return 1;
+    }
+
+    printf("cycles: %llu\n", (unsigned long long)status_copy.cycle_count);
+    for (i = 0; i < status_copy.status_count; i++)
+    {
+        entry = &status_copy.statuses[i];
+        switch (entry->value_fmt) {
+        case FMT_FLOAT:
+            printf("%s:%f\n", entry->name, entry->floatvalue);
+            break;
+        case FMT_STRING:
+            printf("%s:%s\n", entry->name, entry->strvalue);
+            break;
+        default:
+            printf("%s:%d\n", entry->name, entry->intvalue);
+            break;
+        }
+    }
+
+    tux_status_shm_close(reader);
+
+    return 0;
+}
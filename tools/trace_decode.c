@@ -0,0 +1,184 @@
+/*
+ * Tux Droid - Binary trace decoder
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Convert a binary trace of the driver (TuxDrv_StartTrace) to text, or to
+ * CSV with -c. The records are printed in the order of the file; sort the
+ * CSV on its first column to merge the threads by time.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/tux_trace.h"
+
+static const char *type_names[] = {
+    [TUX_TRACE_USB_WRITE] = "usb_write",
+    [TUX_TRACE_USB_READ] = "usb_read",
+    [TUX_TRACE_FRAME_DECODED] = "frame_decoded",
+    [TUX_TRACE_STATUS_EVENT] = "status_event",
+    [TUX_TRACE_CMD_SCHEDULED] = "cmd_scheduled",
+    [TUX_TRACE_CMD_EXECUTED] = "cmd_executed",
+    [TUX_TRACE_RECONNECT] = "reconnect",
+    [TUX_TRACE_LOST] = "lost",
+};
+
+/**
+ *
+ */
+static const char *
+type_name(unsigned int type)
+{
+    if ((type >= sizeof(type_names) / sizeof(type_names[0])) ||
+        (type_names[type] == NULL))
+    {
+        return "unknown";
+    }
+    return type_names[type];
+}
+
+/**
+ *
+ */
+static void
+describe_record(const tux_trace_record_t *record, char *text, size_t size)
+{
+    const uint8_t *d = record->data;
+    uint32_t words[2];
+    float value;
+
+    memcpy(words, d, sizeof(words));
+    switch (record->type)
+    {
+    case TUX_TRACE_USB_WRITE:
+        snprintf(text, size, "%s frame=%.2x %.2x %.2x %.2x %.2x",
+            record->arg ? "failed" : "ok", d[0], d[1], d[2], d[3], d[4]);
+        break;
+    case TUX_TRACE_USB_READ:
+        snprintf(text, size, "frames=%u id=%u rf=%u", record->arg, d[0],
+            d[1]);
+        break;
+    case TUX_TRACE_FRAME_DECODED:
+        snprintf(text, size, "frame=%.2x %.2x %.2x %.2x changed=0x%x", d[0],
+            d[1], d[2], d[3], record->arg);
+        break;
+    case TUX_TRACE_STATUS_EVENT:
+        memcpy(&value, &words[1], sizeof(value));
+        snprintf(text, size, "status=%u seq=%u value=%d (%g)", record->arg,
+            words[0], (int32_t)words[1], value);
+        break;
+    case TUX_TRACE_CMD_SCHEDULED:
+        memcpy(&value, &words[0], sizeof(value));
+        snprintf(text, size, "group=%u cmd=%u sub=%u delay=%g submission=%u",
+            record->arg >> 16, (record->arg >> 8) & 0xFF, record->arg & 0xFF,
+            value, words[1]);
+        break;
+    case TUX_TRACE_CMD_EXECUTED:
+        snprintf(text, size, "group=%u cmd=%u sub=%u submission=%u",
+            record->arg >> 16, (record->arg >> 8) & 0xFF, record->arg & 0xFF,
+            words[0]);
+        break;
+    case TUX_TRACE_RECONNECT:
+        snprintf(text, size, "reconnections=%u", record->arg);
+        break;
+    case TUX_TRACE_LOST:
+        snprintf(text, size, "records=%u", record->arg);
+        break;
+    default:
+        snprintf(text, size, "arg=%u", record->arg);
+        break;
+    }
+}
+
+/**
+ *
+ */
+int
+main(int argc, char *argv[])
+{
+    tux_trace_header_t header;
+    tux_trace_record_t record;
+    const char *path;
+    char text[128];
+    FILE *trace_file;
+    int csv = 0;
+    unsigned long count = 0;
+
+    if ((argc == 3) && !strcmp(argv[1], "-c"))
+    {
+        csv = 1;
+        path = argv[2];
+    }
+    else if (argc == 2)
+    {
+        path = argv[1];
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s [-c] <trace file>\n", argv[0]);
+        return 1;
+    }
+
+    trace_file = fopen(path, "rb");
+    if (trace_file == NULL)
+    {
+        fprintf(stderr, "Can't read %s\n", path);
+        return 1;
+    }
+    if ((fread(&header, sizeof(header), 1, trace_file) != 1) ||
+        (header.magic != TUX_TRACE_MAGIC) ||
+        (header.version != TUX_TRACE_VERSION) ||
+        (header.record_size != sizeof(tux_trace_record_t)))
+    {
+        fprintf(stderr, "%s is not a trace of this version\n", path);
+        fclose(trace_file);
+        return 1;
+    }
+
+    if (csv)
+    {
+        printf("time,thread,type,arg,detail\n");
+    }
+    while (fread(&record, sizeof(record), 1, trace_file) == 1)
+    {
+        describe_record(&record, text, sizeof(text));
+        if (csv)
+        {
+            printf("%.6f,%u,%s,%u,\"%s\"\n",
+                record.timestamp - header.start_time, record.thread,
+                type_name(record.type), record.arg, text);
+        }
+        else
+        {
+            printf("%12.6f [%2u] %-14s %s\n",
+                record.timestamp - header.start_time, record.thread,
+                type_name(record.type), text);
+        }
+        count++;
+    }
+    fclose(trace_file);
+
+    if (!csv)
+    {
+        printf("%lu records\n", count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,616 @@
+/*
+ * Tux Droid - Daemon
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_daemon.c
+ * \brief Daemon which owns the dongle and serves several clients.
+ *
+ * The driver read loop runs in its own thread. Everything else runs in one
+ * epoll loop : the accept of the clients, their requests, and the status
+ * events, which are dispatched in the poll mode when the read loop signals
+ * the end of a cycle. The protocol is in include/tux_daemon_protocol.h.
+ *
+ * Each client has an output buffer. Above OUT_HIGH_WATER, its requests are
+ * not read anymore and its events are dropped until the buffer goes below
+ * OUT_LOW_WATER, so a slow client never holds the others nor the robot.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../include/tux_driver.h"
+#include "../include/tux_daemon_protocol.h"
+
+#define MAX_CLIENTS 64
+#define MAX_EPOLL_EVENTS 32
+#define IN_BUF_SIZE (sizeof(tux_daemon_header_t) + TUX_DAEMON_MAX_PAYLOAD)
+#define OUT_BUF_SIZE (256 * 1024)
+#define OUT_HIGH_WATER (128 * 1024)
+#define OUT_LOW_WATER (32 * 1024)
+
+/** Connected client */
+typedef struct {
+    int fd;
+    unsigned char in_buf[IN_BUF_SIZE]; /**< Partial request */
+    size_t in_len;
+    unsigned char *out_buf; /**< Data not written yet */
+    size_t out_len;
+    uint64_t mask; /**< Subscribed statuses */
+    uint32_t lost; /**< Events dropped since the last notification */
+    uint32_t epoll_flags; /**< Events registered in the epoll set */
+} client_t;
+
+/* Markers of the fds which are not clients in the epoll set */
+static int listen_marker;
+static int wake_marker;
+static int signal_marker;
+
+static client_t *clients[MAX_CLIENTS];
+static int epoll_fd = -1;
+static int wake_fd = -1;
+
+/**
+ *  End cycle callback of the driver, called by the read loop thread.
+ */
+static void
+on_end_cycle(void)
+{
+    uint64_t one = 1;
+
+    if (write(wake_fd, &one, sizeof(one)) < 0)
+    {
+        /* The counter is full, the loop is already woken up */
+    }
+}
+
+/**
+ *  Read loop of the driver.
+ */
+static void *
+driver_thread(void *param)
+{
+    (void)param;
+    TuxDrv_Start();
+    return NULL;
+}
+
+/**
+ *  Update the epoll events of a client.
+ */
+static void
+update_client_flags(client_t *client)
+{
+    struct epoll_event ev;
+    uint32_t flags = 0;
+
+    if (client->out_len < OUT_HIGH_WATER)
+    {
+        /* Reading is resumed below the low water mark only */
+        if ((client->epoll_flags & EPOLLIN) ||
+            (client->out_len < OUT_LOW_WATER))
+        {
+            flags |= EPOLLIN;
+        }
+    }
+    if (client->out_len > 0)
+    {
+        flags |= EPOLLOUT;
+    }
+    if (flags == client->epoll_flags)
+    {
+        return;
+    }
+
+    ev.events = flags;
+    ev.data.ptr = client;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+    client->epoll_flags = flags;
+}
+
+/**
+ *  Append a message to the output buffer of a client.
+ *  @param limit Maximal size of the buffer after the append.
+ *  @return 0 on success, -1 if the message does not fit.
+ */
+static int
+queue_message(client_t *client, uint16_t type, const void *payload,
+        size_t size, const void *extra, size_t extra_size, size_t limit)
+{
+    tux_daemon_header_t header;
+    size_t total = sizeof(header) + size + extra_size;
+
+    if ((client->out_len + total) > limit)
+    {
+        return -1;
+    }
+
+    header.type = type;
+    header.reserved = 0;
+    header.length = size + extra_size;
+    memcpy(client->out_buf + client->out_len, &header, sizeof(header));
+    client->out_len += sizeof(header);
+    memcpy(client->out_buf + client->out_len, payload, size);
+    client->out_len += size;
+    if (extra_size > 0)
+    {
+        memcpy(client->out_buf + client->out_len, extra, extra_size);
+        client->out_len += extra_size;
+    }
+
+    return 0;
+}
+
+/**
+ *  Close a client connection.
+ */
+static void
+close_client(client_t *client)
+{
+    int i;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i] == client)
+        {
+            clients[i] = NULL;
+        }
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client->out_buf);
+    free(client);
+}
+
+/**
+ *  Write the pending output of a client.
+ *  @return 0 on success, -1 if the client was closed.
+ */
+static int
+flush_client(client_t *client)
+{
+    ssize_t written;
+
+    while (client->out_len > 0)
+    {
+        written = send(client->fd, client->out_buf, client->out_len,
+                MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            close_client(client);
+            return -1;
+        }
+        memmove(client->out_buf, client->out_buf + written,
+                client->out_len - written);
+        client->out_len -= written;
+    }
+
+    update_client_flags(client);
+
+    return 0;
+}
+
+/**
+ *  Status event callback, called in the epoll loop by
+ *  TuxDrv_DispatchStatusEvents().
+ */
+static void
+on_status_event(const drv_status_event_t *event)
+{
+    tux_daemon_event_t msg;
+    tux_daemon_events_lost_t lost;
+    size_t str_size = 0;
+    int i;
+
+    msg.id = event->id;
+    msg.value_fmt = event->value_fmt;
+    msg.intvalue = event->intvalue;
+    msg.floatvalue = event->floatvalue;
+    msg.timestamp = event->timestamp;
+    msg.seq = event->seq;
+    msg.reserved = 0;
+    if (event->strvalue != NULL)
+    {
+        str_size = strlen(event->strvalue);
+    }
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        client_t *client = clients[i];
+
+        if ((client == NULL) || !(client->mask & STATUS_MASK(event->id)))
+        {
+            continue;
+        }
+        if (client->lost > 0)
+        {
+            lost.count = client->lost;
+            if (queue_message(client, TUX_MSG_EVENTS_LOST, &lost,
+                    sizeof(lost), NULL, 0, OUT_HIGH_WATER) == 0)
+            {
+                client->lost = 0;
+            }
+        }
+        if ((client->lost > 0) ||
+            (queue_message(client, TUX_MSG_EVENT, &msg, sizeof(msg),
+                event->strvalue, str_size, OUT_HIGH_WATER) < 0))
+        {
+            client->lost++;
+        }
+    }
+}
+
+/**
+ *  Execute a request of a client and queue its answer.
+ */
+static void
+handle_request(client_t *client, const tux_daemon_header_t *header,
+        const unsigned char *payload)
+{
+    tux_daemon_result_t result;
+    tux_daemon_command_t command;
+    tux_daemon_subscribe_t subscribe;
+    char text[TUX_DAEMON_MAX_PAYLOAD + 1];
+    size_t text_size;
+
+    result.request = header->type;
+    result.reserved = 0;
+    result.error = E_TUXDRV_NOERROR;
+
+    switch (header->type) {
+    case TUX_MSG_COMMAND:
+        if (header->length < sizeof(command))
+        {
+            result.error = E_TUXDRV_INVALIDCOMMAND;
+            break;
+        }
+        memcpy(&command, payload, sizeof(command));
+        text_size = header->length - sizeof(command);
+        if (text_size > TUX_DAEMON_MAX_COMMAND)
+        {
+            result.error = E_TUXDRV_INVALIDPARAMETER;
+            break;
+        }
+        memcpy(text, payload + sizeof(command), text_size);
+        text[text_size] = '\0';
+        /* Never does the USB I/O in the event loop */
+        result.error = TuxDrv_QueueCommand(command.delay, text);
+        break;
+    case TUX_MSG_MACRO:
+        if (header->length > TUX_DAEMON_MAX_MACRO)
+        {
+            result.error = E_TUXDRV_INVALIDPARAMETER;
+            break;
+        }
+        memcpy(text, payload, header->length);
+        text[header->length] = '\0';
+        result.error = TuxDrv_PerformMacroText(text);
+        break;
+    case TUX_MSG_CLEAR:
+        TuxDrv_ClearCommandStack();
+        break;
+    case TUX_MSG_SUBSCRIBE:
+        if (header->length < sizeof(subscribe))
+        {
+            result.error = E_TUXDRV_INVALIDPARAMETER;
+            break;
+        }
+        memcpy(&subscribe, payload, sizeof(subscribe));
+        client->mask = subscribe.mask;
+        break;
+    default:
+        result.error = E_TUXDRV_INVALIDCOMMAND;
+        break;
+    }
+
+    /* Reading stops at the high water mark, an answer always fits */
+    queue_message(client, TUX_MSG_RESULT, &result, sizeof(result), NULL, 0,
+            OUT_BUF_SIZE);
+}
+
+/**
+ *  Execute the complete requests received from a client.
+ *  @return 0 on success, -1 if the client was closed.
+ */
+static int
+process_requests(client_t *client)
+{
+    tux_daemon_header_t header;
+    size_t offset;
+
+    offset = 0;
+    while ((client->in_len - offset) >= sizeof(header))
+    {
+        memcpy(&header, client->in_buf + offset, sizeof(header));
+        if (header.length > TUX_DAEMON_MAX_PAYLOAD)
+        {
+            fprintf(stderr, "Client %d : message too large\n", client->fd);
+            close_client(client);
+            return -1;
+        }
+        if ((client->in_len - offset) < (sizeof(header) + header.length))
+        {
+            break;
+        }
+        handle_request(client, &header,
+                client->in_buf + offset + sizeof(header));
+        offset += sizeof(header) + header.length;
+        if (client->out_len >= OUT_HIGH_WATER)
+        {
+            /* The next requests wait for the client to read its answers */
+            break;
+        }
+    }
+    memmove(client->in_buf, client->in_buf + offset, client->in_len - offset);
+    client->in_len -= offset;
+
+    return flush_client(client);
+}
+
+/**
+ *  Read the requests of a client.
+ */
+static void
+read_client(client_t *client)
+{
+    ssize_t received;
+
+    /* Requests left when the reading stopped at the high water mark */
+    if ((client->in_len > 0) && (process_requests(client) < 0))
+    {
+        return;
+    }
+    if (client->in_len == IN_BUF_SIZE)
+    {
+        /* The answers must be read before the next requests */
+        return;
+    }
+
+    received = read(client->fd, client->in_buf + client->in_len,
+            IN_BUF_SIZE - client->in_len);
+    if (received < 0)
+    {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        {
+            return;
+        }
+        close_client(client);
+        return;
+    }
+    if (received == 0)
+    {
+        close_client(client);
+        return;
+    }
+    client->in_len += received;
+
+    process_requests(client);
+}
+
+/**
+ *  Accept the pending connections.
+ */
+static void
+accept_clients(int listen_fd)
+{
+    struct epoll_event ev;
+    client_t *client;
+    int fd;
+    int i;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0)
+    {
+        for (i = 0; (i < MAX_CLIENTS) && (clients[i] != NULL); i++)
+        {
+        }
+        client = NULL;
+        if (i < MAX_CLIENTS)
+        {
+            client = (client_t *)calloc(1, sizeof(client_t));
+        }
+        if (client != NULL)
+        {
+            client->out_buf = (unsigned char *)malloc(OUT_BUF_SIZE);
+        }
+        if ((client == NULL) || (client->out_buf == NULL))
+        {
+            fprintf(stderr, "Client refused\n");
+            free(client);
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        client->fd = fd;
+        client->epoll_flags = EPOLLIN;
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        clients[i] = client;
+    }
+}
+
+/**
+ *
+ */
+int
+main(int argc, char *argv[])
+{
+    const char *socket_path = TUX_DAEMON_SOCKET_PATH;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    struct epoll_event ev;
+    struct sockaddr_un addr;
+    pthread_t driver;
+    sigset_t signals;
+    struct signalfd_siginfo signal_info;
+    uint64_t wake_count;
+    int listen_fd;
+    int signal_fd;
+    int running = 1;
+    int count;
+    int i;
+
+    if (argc > 1)
+    {
+        socket_path = argv[1];
+    }
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long\n");
+        return 1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if ((listen_fd < 0) ||
+        (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(listen_fd, 16) < 0))
+    {
+        fprintf(stderr, "Can't listen on %s : %s\n", socket_path,
+                strerror(errno));
+        return 1;
+    }
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    /* A client closed before its replies must not stop the daemon */
+    signal(SIGPIPE, SIG_IGN);
+    /* Blocked before the driver thread starts, which inherits the mask */
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    epoll_fd = epoll_create1(0);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listen_marker;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.ptr = &wake_marker;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+    ev.data.ptr = &signal_marker;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+
+    TuxDrv_SetStatusCallbackEx(on_status_event);
+    TuxDrv_SetStatusDispatchMode(STATUS_DISPATCH_POLL,
+            STATUS_OVERFLOW_COALESCE);
+    TuxDrv_SetEndCycleCallback(on_end_cycle);
+    pthread_create(&driver, NULL, driver_thread, NULL);
+
+    while (running)
+    {
+        count = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+        for (i = 0; i < count; i++)
+        {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &listen_marker)
+            {
+                accept_clients(listen_fd);
+            }
+            else if (ptr == &signal_marker)
+            {
+                while (read(signal_fd, &signal_info, sizeof(signal_info)) ==
+                        (ssize_t)sizeof(signal_info))
+                {
+                    if ((signal_info.ssi_signo == SIGINT) ||
+                        (signal_info.ssi_signo == SIGTERM))
+                    {
+                        running = 0;
+                    }
+                }
+            }
+            else if (ptr == &wake_marker)
+            {
+                if (read(wake_fd, &wake_count, sizeof(wake_count)) > 0)
+                {
+                    TuxDrv_DispatchStatusEvents(0);
+                }
+            }
+            else
+            {
+                client_t *client = (client_t *)ptr;
+
+                if (events[i].events & EPOLLIN)
+                {
+                    /* Also reads the end of file of a hung up client */
+                    read_client(client);
+                }
+                else if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    close_client(client);
+                }
+                else if (events[i].events & EPOLLOUT)
+                {
+                    if ((flush_client(client) == 0) &&
+                        (client->epoll_flags & EPOLLIN) &&
+                        (client->in_len > 0))
+                    {
+                        /* Requests left when the reading stopped */
+                        process_requests(client);
+                    }
+                }
+            }
+        }
+
+        /* Send the events queued by the dispatch */
+        for (i = 0; i < MAX_CLIENTS; i++)
+        {
+            if ((clients[i] != NULL) && (clients[i]->out_len > 0))
+            {
+                flush_client(clients[i]);
+            }
+        }
+    }
+
+    TuxDrv_Stop();
+    pthread_join(driver, NULL);
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i] != NULL)
+        {
+            close_client(clients[i]);
+        }
+    }
+    close(listen_fd);
+    unlink(socket_path);
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Tux Droid - Status shared memory reader
+ * Copyright (C) 2008 C2ME Sa <Acness : remi.jocaille@c2me.be>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/**
+ * \file tux_status_shm_reader.c
+ * \brief Reader of the status shared memory.
+ *
+ * The segment is mapped read-only once, then each read is a copy without
+ * system call nor lock. The reader never needs the dongle nor the driver.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/tux_status_shm.h"
+
+/** \brief Maximal number of tries of a read while the driver writes */
+#define READ_RETRIES 1000
+
+/** \brief Reader handle */
+struct tux_status_shm_reader {
+    const tux_status_shm_t *segment; /**< Read-only mapping */
+};
+
+/**
+ * \brief Map a status shared memory segment.
+ * \param name Name of the segment, NULL for TUX_STATUS_SHM_NAME.
+ * \return The reader, NULL if the segment does not exist.
+ */
+tux_status_shm_reader_t *
+tux_status_shm_open(const char *name)
+{
+    tux_status_shm_reader_t *reader;
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (name == NULL)
+    {
+        name = TUX_STATUS_SHM_NAME;
+    }
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(tux_status_shm_t)))
+    {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, sizeof(tux_status_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    reader = (tux_status_shm_reader_t *)malloc(sizeof(tux_status_shm_reader_t));
+    if (reader == NULL)
+    {
+        munmap(map, sizeof(tux_status_shm_t));
+        return NULL;
+    }
+    reader->segment = (const tux_status_shm_t *)map;
+
+    return reader;
+}
+
+/**
+ * \brief Copy a consistent view of the segment.
+ * \param reader Reader handle.
+ * \param copy Output copy.
+ * \return 0 on success, -1 if the segment is not published or the driver
+ * kept writing during all the tries.
+ */
+int
+tux_status_shm_read(tux_status_shm_reader_t *reader, tux_status_shm_t *copy)
+{
+    uint32_t seq;
+    int i;
+
+    if ((reader == NULL) || (copy == NULL))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < READ_RETRIES; i++)
+    {
+        seq = reader->segment->seq;
+        if (seq & 1)
+        {
+            continue;
+        }
+        __sync_synchronize();
+        memcpy(copy, (const void *)reader->segment, sizeof(tux_status_shm_t));
+        __sync_synchronize();
+        if (seq == reader->segment->seq)
+        {
+            if ((copy->magic != TUX_STATUS_SHM_MAGIC) ||
+                (copy->version != TUX_STATUS_SHM_VERSION))
+            {
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * \brief Find a status by its name in a copy of the segment.
+ * \param copy Copy of the segment.
+ * \param name Name of the status.
+ * \return The index of the status, -1 if not found.
+ */
+int
+tux_status_shm_find(const tux_status_shm_t *copy, const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; (i < copy->status_count) && (i < TUX_STATUS_SHM_STATUSES);
+         i++)
+    {
+        if (!strcmp(copy->statuses[i].name, name))
+        {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * \brief Unmap a status shared memory segment.
+ * \param reader Reader handle.
+ */
+void
+tux_status_shm_close(tux_status_shm_reader_t *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+
+    munmap((void *)reader->segment, sizeof(tux_status_shm_t));
+    free(reader);
+}